@@ -0,0 +1,33 @@
+#pragma once
+#include "move.hpp"
+#include "pieces.hpp"
+
+#include <array>
+
+namespace chess
+{
+	// set-wise attack generation, every piece of a type at once rather than one lookup per piece
+	namespace attacks
+	{
+		// \param colour: the colour of the pawns
+		Bitmap pawnAttacks(Bitmap pawns, PieceColour colour);
+		Bitmap knightAttacks(Bitmap knights);
+		Bitmap kingAttacks(Bitmap kings);
+		// every position seen by a set of sliders
+		// uses AVX2 to fill all four directions at once when the cpu supports it
+		// \param rookSliders: rooks and queens
+		// \param bishopSliders: bishops and queens
+		// \param empty: positions the sliders can see through
+		Bitmap sliderAttacks(Bitmap rookSliders, Bitmap bishopSliders, Bitmap empty);
+
+		// pieces from teamMap that are the only piece between a slider and the king
+		// \param all: positions of every piece on the board
+		Bitmap blockers(int kingPos, Bitmap teamMap, Bitmap all, Bitmap rookSliders, Bitmap bishopSliders);
+	}
+
+	// every position on the full line through two aligned positions, including them
+	// empty when the positions aren't on a rank, file or diagonal together
+	extern const std::array<std::array<Bitmap, 64>, 64> lineLookup;
+	// every position strictly between two aligned positions
+	extern const std::array<std::array<Bitmap, 64>, 64> betweenLookup;
+}
@@ -4,12 +4,12 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <array>
-#include <stack>
 
 namespace chess
 {
-	const Bitmap bitset[64] = {
+	constexpr Bitmap bitset[64] = {
 		0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80, 
 		0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000, 0x8000, 
 		0x10000, 0x20000, 0x40000, 0x80000, 0x100000, 0x200000, 0x400000, 0x800000,
@@ -46,20 +46,65 @@ namespace chess
 	//using BoardState = unsigned int;
 	struct BoardState {
 		int moveCount;
-		uint8_t halfMoveCount;
+		int halfMoveCount;
 		bool wlc, wrc, blc, brc;
 		Bitmap epMap;
 		bool isCapture;
 		Type capture;
 
 		Zobrist zobrist;
+		Zobrist pawnKey;
+		Zobrist materialKey;
+		Bitmap checkers;
+		Bitmap pinned;
+		int pliesFromNull;
 	};
 
-	struct Board {
+	// number of states StateHistory keeps, a power of 2
+	constexpr size_t HISTORY_SIZE = 1024;
+
+	// fixed capacity stack of past board states that never allocates
+	// once full the oldest states are overwritten, so only the last HISTORY_SIZE moves can be unmade
+	class StateHistory {
+	public:
+		StateHistory();
+		// copies only the states in use rather than the whole capacity
+		StateHistory(const StateHistory& other);
+		StateHistory& operator=(const StateHistory& other);
+
+		void push(const BoardState& state);
+		// removes and returns the most recent state
+		BoardState pop();
+		const BoardState& top() const;
+		// the state index moves before the top, so fromTop(0) is top()
+		const BoardState& fromTop(size_t index) const;
+		// number of states that can be popped
+		size_t size() const;
+	private:
+		BoardState states[HISTORY_SIZE];
+		size_t count; // pushes minus pops, wraps around the array
+	};
+
+	// a position in 32 bytes, for storing and sending positions without parsing text
+	// the bytes are the same on every little endian machine, so it can be written straight to disk
+	struct PackedPosition {
+		Bitmap occupancy;      // every piece
+		uint8_t pieces[16];    // 4 bits for each piece in occupancy from the lowest bit, type + 6 * colour
+		uint8_t state;         // bit 0 = colour to move, 1 = wlc, 2 = wrc, 3 = blc, 4 = brc
+		uint8_t epColumn;      // column of the en passant position from a, 0 when there is none
+		uint8_t halfMoves;     // capped at 255
+		uint8_t unused;
+		uint32_t currentMove;
+	};
+
+	// everything about a position needed to generate and make moves, without the history
+	// trivially copyable so that search can copy-make with Position::afterMove instead of unmaking
+	struct Position {
 	public:
 		Bitmap positions[2][6]; //arrays of bitmaps for each team and piece
 		Bitmap teamMaps[2];     // arrays of bitmaps for whole teams
 		Bitmap all;             // bitmap for every piece
+		Type mailbox[64];       // the type of the piece on each position, NO_PIECE when empty
 
 		Bitmap epMap; // bitmap for takeable en passant position
 
@@ -67,13 +112,69 @@ namespace chess
 		CastleRules rightCastles;
 		CastleRules leftCastles;
 
-		int currentMove;
+		int currentMove; // plies since the start of the game
 		int halfMoves;
 		Colour colour;
+		// plies since the last null move, positions before it can't be repeated
+		int pliesFromNull;
 
 		Zobrist zobrist;
+		// hash of only the pawns, for caching pawn structure evaluation
+		Zobrist pawnKey;
+		// hash of how many of each piece each team has, wherever they are
+		Zobrist materialKey;
+
+		// enemy pieces checking the king of the team to move
+		Bitmap checkers;
+		// pieces of the team to move that are pinned to their king
+		Bitmap pinned;
+
+		// whether the team to move is in check
+		bool isCheck() const;
 
-		std::stack<BoardState> pastStates;
+		// the type of the piece on a position, NO_PIECE when it is empty
+		// the colour comes from Position::teamMaps
+		Type pieceOn(int position) const;
+
+		// the position after a move, leaving this one untouched
+		// NOTE this does not take legality into account
+		Position afterMove(Move move) const;
+		template <PieceColour us>
+		Position afterMove(Move move) const;
+
+	protected:
+		// makes a move without saving anything to undo it
+		template <PieceColour us> void applyMove(Move move);
+
+		// moving 1 friendly piece to a different square.
+		// does not affect the opposing team
+		template <PieceColour us> void movePieceDefault(Bitmap start, Bitmap end, Type pieceType);
+		template <PieceColour us> void movePieceEp(Bitmap start, Bitmap end);
+		template <PieceColour us> void movePiecePromotion(Bitmap start, Bitmap end, Type promotionType);
+		template <PieceColour us> void movePieceCastle(Bitmap start, Bitmap end);
+		// removes an enemy piece from the board
+		template <PieceColour us> void takePiece(Bitmap position, Type pieceType);
+		// updates Position::epMap after a pawn has been moved
+		template <PieceColour us> void updateEpMap(Bitmap start, Bitmap end);
+		// increments each game state variable after one ply (move or null move)
+		void incrementGameState();
+		// remakes Position::teamMaps and Position::all from the piece bitmaps
+		// moves update them incrementally, so this is only needed when setting up a position
+		void updateTeamPositions();
+		// removes a castling right when a rook is moved
+		void removeSingleCastle(Bitmap rookPosition, Colour clr);
+		// loads Position::checkers and Position::pinned for the team to move
+		template <PieceColour us> void loadCheckInfo();
+		void loadCheckInfo();
+		// remakes this->zobrist, this->pawnKey and this->materialKey
+		// this is slow, only use it in constructor
+		void loadZobrist();
+	};
+
+	// a Position with the history needed to unmake moves
+	struct Board : public Position {
+	public:
+		StateHistory pastStates;
 
 		Board(Bitmap wp, Bitmap wn, Bitmap wb, Bitmap wr, Bitmap wq, Bitmap wk, Bitmap bp, Bitmap bn, Bitmap bb, Bitmap br, Bitmap bq, Bitmap bk, Bitmap ep,
 		      bool wlc, bool wrc, bool blc, bool brc, int move_count, int hm, Colour colour);
@@ -82,7 +183,16 @@ namespace chess
 		bool operator==(Board& other);
 
 		// returns a fully initialied instance of a Board from a FEN string
-		static Board fromFen(std::string fen); 
+		// the move counts may be left off, throws std::invalid_argument when the FEN is malformed
+		static Board fromFen(std::string_view fen);
+		// the FEN string of the position, the reverse of Board::fromFen
+		std::string toFen() const;
+
+		// returns a fully initialised Board from a packed position
+		// throws std::invalid_argument when the packed position is malformed
+		static Board fromPacked(const PackedPosition& packed);
+		// the packed position, the reverse of Board::fromPacked
+		PackedPosition toPacked() const;
 
 		std::string toString() const;
 
@@ -94,30 +204,34 @@ namespace chess
 
 		void unmakeMove(Move move);
 
+		// passes the turn to the other team without moving a piece
+		// NOTE the team to move must not be in check
+		void makeNullMove();
+		void unmakeNullMove();
+
+		// whether the position is a draw by repetition since the last capture or pawn move
+		// \param ply: distance from the root of the search, a repeat within it is a draw but one from before needs 3 occurrences
+		bool isRepetition(int ply) const;
+		// whether there have been 50 moves each without a capture or pawn move
+		bool isFiftyMoveDraw() const;
+		// whether the team to move has a move that repeats a position, making a draw already reachable
+		// uses a cuckoo table of every reversible move's zobrist change
+		// \param ply: distance from the root of the search, earlier positions are ignored
+		bool hasUpcomingRepetition(int ply) const;
+
+		// makeMove and unmakeMove specialised for the team making the move
+		// us must be Board::colour for makeMove and !Board::colour for unmakeMove
+		template <PieceColour us>
+		void makeMove(Move move);
+		template <PieceColour us>
+		void unmakeMove(Move move);
+
 	private:
+		// a Board with no history from a Position that is already fully set up, used by Board::fromPacked
+		explicit Board(const Position& position);
+
 		void setPositions(Bitmap wp, Bitmap wn, Bitmap wb, Bitmap wr, Bitmap wq, Bitmap wk, Bitmap bp, Bitmap bn, Bitmap bb, Bitmap br, Bitmap bq, Bitmap bk);
 		void setGameState(Bitmap ep, bool wlc, bool wrc, bool blc, bool brc, int moveCount, int hm, Colour clr);
-
-		// moving 1 friendly piece to a different square.
-		// does not affect the opposing team
-		void movePieceDefault(Bitmap start, Bitmap end, Type pieceType);
-		void movePieceEp(Bitmap start, Bitmap end);
-		void movePiecePromotion(Bitmap start, Bitmap end, Type promotionType);
-		void movePieceCastle(Bitmap start, Bitmap end);
-		// removes an enemy piece from the board
-		void takePiece(Bitmap position, Type pieceType);
-		// updates Board::epMap after a pawn has been moved
-		void updateEpMap(Bitmap start, Bitmap end);
-		// increments each game state variable after one ply (move)
-		void incrementGameState();
-		// updates Board::teamMaps and Board::all
-		void updateTeamPositions();
-		// removes a castling right when a rook is moved
-		void removeSingleCastle(Bitmap rookPosition, Colour clr);
-		// remakes this->zobrist
-		// this is slow, only use it in constructor
-		void loadZobrist();
-
 	};
 
 }
\ No newline at end of file
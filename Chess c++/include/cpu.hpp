@@ -0,0 +1,23 @@
+#pragma once
+
+// msvc allows intrinsics from any instruction set in any function, gcc and clang need them enabled per function
+#if defined(__GNUC__)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#define BMI2_FUNCTION __attribute__((target("bmi2")))
+#else
+#define AVX2_FUNCTION
+#define BMI2_FUNCTION
+#endif
+
+namespace chess
+{
+	// instruction sets of the cpu running the program
+	// cpuid is read once, the first time either is called
+	namespace cpu
+	{
+		// whether the cpu has a fast BMI2 pext instruction
+		bool hasPext();
+		// whether the cpu and os support AVX2
+		bool hasAvx2();
+	}
+}
@@ -10,6 +10,7 @@
 #include "pieces.hpp"
 
 #include <vector>
+#include <stack>
 
 namespace chess
 {
@@ -12,16 +12,39 @@ namespace chess
 {
 	struct MoveList;
 
+	// which of the legal moves a generator call adds
+	enum class MoveType {
+		ALL,
+		CAPTURES, // moves onto an enemy piece (including promotions) and en passant
+		QUIETS,   // every other move, including castling and promotion pushes
+		QUIET_CHECKS // quiet moves that give check and promotion pushes, nothing when in check
+	};
+
 	class Generator {
 	public:
 		Generator();
-		Generator(Board& pboard);
+		Generator(Position& pboard);
+
 
+		void getLegalMoves(MoveList* moveList, MoveType type=MoveType::ALL);
+		// getLegalMoves specialised for the side to move, us must be board->colour
+		template <PieceColour us>
+		void getLegalMoves(MoveList* moveList, MoveType type=MoveType::ALL);
+		Position* board;
 
-		void getLegalMoves(MoveList* moveList, bool captures=false);
-		Board* board;
+		// loads the check, attack and pin masks for the current position
+		// getLegalMoves does this itself, it is only needed before getLoadedMoves and isLegal
+		void loadMasks();
+		// adds legal moves using the masks from the last loadMasks call
+		// lets a position be generated in several parts without reloading the masks
+		void getLoadedMoves(MoveList* moveList, MoveType type);
+		// whether a move is legal, using the masks from the last loadMasks call
+		// used to check moves from the transposition table and killers without generating
+		bool isLegal(Move move);
 
 		bool isCheck();
+		// whether the enemy attacks a position, using the masks from the last loadMasks call
+		bool isAttacked(int position);
 		
 	private:
 		MoveList* moves;
@@ -32,32 +55,46 @@ namespace chess
 		Bitmap checkMask;
 		// positions of every attacked position by the enemy
 		Bitmap attackMask;
-		// the positions every piece can move to whilst not opening a pin
-		Bitmap pinMasks[64];
-
-		void loadEnemyEmptyMask();
-		void loadCheckMask();
-		void loadAttackMask();
-		void loadPinMasks();
+		// position of the king of the team to move
+		int kingPosition;
+		// the positions each piece type would check the enemy king from
+		// only loaded for MoveType::QUIET_CHECKS
+		Bitmap checkSquares[6];
+		// positions of every piece that would give a discovered check by moving off its line
+		Bitmap discoverers;
+
+		template <PieceColour us> void loadMasks();
+		template <PieceColour us> void getLoadedMoves(MoveList* moveList, MoveType type);
+		template <PieceColour us> bool isLegal(Move move);
+
+		template <PieceColour us> void loadEnemyEmptyMask();
+		template <PieceColour us> void loadCheckMask();
+		template <PieceColour us> void loadAttackMask();
+		template <PieceColour us> void loadCheckSquares();
 		// used for checking when en passant pawns are taken
 		bool isPinned(Bitmap posMap);
+		// the positions a piece can move to whilst not opening a pin
+		Bitmap pinMask(int position);
 
 		// adding moves onto Generator::moves
 		void addMoves(int position, Bitmap map, Flag flag, Type promotionPiece);
 		
-		void addPawnMoves();
-		void addKnightMoves();
-		void addBishopMoves();
-		void addRookMoves();
-		void addQueenMoves();
-		void addKingMoves();
-
-		void addCastleMoves();
-		void addPromotionMoves();
-		void addEnPassantMoves();
+		template <PieceColour us> void addPawnMoves();
+		template <PieceColour us> void addKnightMoves();
+		template <PieceColour us> void addBishopMoves();
+		template <PieceColour us> void addRookMoves();
+		template <PieceColour us> void addQueenMoves();
+		template <PieceColour us> void addKingMoves();
+
+		template <PieceColour us> void addCastleMoves();
+		template <PieceColour us> void addPromotionMoves();
+		template <PieceColour us> void addEnPassantMoves();
+		// adds the moves that get out of check, instead of every add*Moves
+		template <PieceColour us> void addEvasions(MoveType type);
+		template <PieceColour us> void addQuietChecks();
 
 		// return bitmasks of all the pseudo legal move positions from an integer position
-		Bitmap pseudoPawn(int pos);
+		template <PieceColour us> Bitmap pseudoPawn(int pos);
 		Bitmap pseudoKnight(int pos);
 		Bitmap pseudoBishop(int pos);
 		Bitmap pseudoRook(int pos);
@@ -75,6 +112,10 @@ namespace chess
 
 		void add(Move move);
 
+		Move& operator[](size_t index);
+		// shrinks the list to its first newSize moves
+		void resize(size_t newSize);
+
 		iterator begin();
 		iterator end();
 
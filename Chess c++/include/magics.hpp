@@ -1,29 +1,41 @@
 #pragma once
 #include "move.hpp"
 
-#include <vector>
+#include <array>
 
 namespace chess
 {
+	// number of entries in the shared slider attack table
+	// sum of (1 << bits) over every rook and bishop square
+	// only the magic ordered table is built at compile time, the pext order is copied from it by initPextLookups
+	constexpr size_t SLIDER_TABLE_SIZE = 102400 + 5248;
+
+	// fills the pext ordered attack table on cpus that use pext, until then lookups use the magic table
+	// only the first call does any work, Board's constructors call it before any lookups are made
+	void initPextLookups();
+
 	struct MagicLookup {
 	public:
-		MagicLookup();
+		constexpr MagicLookup() : mask(0), magic(0), offset(0), numBits(0) {}
+		// only constructed at compile time, in magics.cpp
 		// \param sq: the square the magic is for
-		// \param bshp: whether the piece is a bishop (otherwise a rook)
-		MagicLookup(int sq, bool bshp);
+		// \param isBishop: whether the piece is a bishop (otherwise a rook)
+		constexpr MagicLookup(int sq, bool isBishop);
 		// gets the pseudo move mask for the piece when facing allBoard
 		// \param allBoard: positions of every piece on the board
 		// \return mask of pseudo move positions that can be made
-		Bitmap operator[] (Bitmap allBoard);
+		Bitmap operator[] (Bitmap allBoard) const;
 	private:
-		int square;      // square on the boardthe lookup is for 
-		bool isBishop;   // True bishop; False rook
 		Bitmap mask;    // the positions that the piece would see without any enemies on the board
 		Bitmap magic;   // magic number to transform the mask with a given blocker board
+		uint32_t offset; // start of this square's slice of the shared attack table
 		int numBits;     // number of bits in mask
-		std::vector<Bitmap> lookup;
 
 	};
 
+	// slider lookups for each square, generated at compile time
+	extern const std::array<MagicLookup, 64> bishopPseudoLookup;
+	extern const std::array<MagicLookup, 64> rookPseudoLookup;
+
 
-}
\ No newline at end of file
+}
\ No newline at end of file
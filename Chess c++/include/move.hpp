@@ -4,6 +4,8 @@
 
 #include <memory>
 #include <string>
+#include <compare>
+#include <cstdint>
 
 namespace chess
 {
@@ -22,42 +24,58 @@ namespace chess
 	// 6-11 end position
 	// 12-13 flag
 	// 14-15 piece: knight(0), bishop(1), rook(2), queen(3)
-	using Move = int;
-	const int NULL_MOVE = 0;
+	struct Move {
+	public:
+		uint16_t value;
 
-	Move makeMove(int start, int end);
-	Move makeMove(int start, int end, Flag flag, Type promotion);
+		Move() = default;
+		constexpr explicit Move(uint16_t pValue) : value(pValue) {}
+		constexpr auto operator<=>(const Move& other) const = default;
+	};
+	constexpr Move NULL_MOVE = Move(0);
 
-	Move makePromotion(int start, int end, Type piece);
-	Move makeEnPassant(int start, int end);
-	Move makeCastle(int start, int end);
+	// takes either knight, bishop, rook, queen and squashes it to the first 2 bits
+	constexpr int pieceToPromotionCode(Type piece) {
+		if (piece < 1) return 0;
+		return piece - 1;
+	}
 
-	int getStart(Move move);
-	int getEnd(Move move);
-	Flag getFlag(Move move);
-	Type getPromotion(Move move);
+	constexpr Move makeMove(int start, int end) {
+		return Move((uint16_t)(start | (end << 6)));
+	}
 
-	std::string notate(Move move);
+	constexpr Move makeMove(int start, int end, Flag flag, Type promotion) {
+		return Move((uint16_t)(start | (end << 6) | ((int)flag << 12) | (pieceToPromotionCode(promotion) << 14)));
+	}
 
-	
-	/*struct Move {
-	public:
-		int value;
-		bool operator==(Move other);
-
-		Move(int pStart, int pEnd);
-		Move(int pStart, int pEnd, Flag flag, Type pPiece);
-		Move();
-		static Move promotion(int pStart, int pEnd, Type pPiece);
-		static Move enPassant(int pStart, int pEnd);
-		static Move castle(int pStart, int pEnd);
-
-		int start();
-		int end();
-		Flag flag();
-		Type promotionPiece();
-
-		std::string notate();
-	};*/
+	constexpr Move makePromotion(int start, int end, Type piece) {
+		return makeMove(start, end, Flag::PROMOTION, piece);
+	}
+
+	constexpr Move makeEnPassant(int start, int end) {
+		return makeMove(start, end, Flag::EN_PASSANT, PAWN);
+	}
+
+	constexpr Move makeCastle(int start, int end) {
+		return makeMove(start, end, Flag::CASTLE, PAWN);
+	}
+
+	constexpr int getStart(Move move) {
+		return move.value & 0b111111;
+	}
+
+	constexpr int getEnd(Move move) {
+		return (move.value >> 6) & 0b111111;
+	}
+
+	constexpr Flag getFlag(Move move) {
+		return (Flag)(move.value >> 12 & 0b11);
+	}
+
+	constexpr Type getPromotion(Move move) {
+		return ((move.value >> 14) & 0b11) + 1;
+	}
+
+	std::string notate(Move move);
 
 }
\ No newline at end of file
@@ -8,4 +8,51 @@
 namespace chess {
 	// sorts moves to speed up alpha beta pruning
 	void order(const Board& board, MoveList& moves, TranspositionTable& tt);
-}
\ No newline at end of file
+
+	// hands out the legal moves of a position one at a time, best first
+	// moves are generated in stages, so a cutoff on an early move skips generating and scoring the rest
+	// order: hash move, good captures, killers, quiets, bad captures
+	class MovePicker {
+	public:
+		// \param hashMove: the transposition table's move for this position (or NULL_MOVE)
+		// \param killerMoves: two quiet moves that caused cutoffs at this ply
+		MovePicker(Board& pboard, Move hashMove, const Move killerMoves[2]);
+
+		// \return the next move to search, or NULL_MOVE once every legal move has been given
+		Move next();
+
+	private:
+		enum class Stage {
+			HASH_MOVE,
+			GENERATE_CAPTURES,
+			GOOD_CAPTURES,
+			KILLERS,
+			GENERATE_QUIETS,
+			QUIETS,
+			BAD_CAPTURES,
+			DONE
+		};
+
+		Board& board;
+		Generator generator;
+		Stage stage;
+
+		Move hashMove;
+		Move killers[2];
+		int killerIndex;
+
+		// moves of the current stage, with a score for each
+		MoveList moves;
+		int scores[maxMoveCount];
+		size_t current;
+		// captures that lose material, tried after the quiets
+		MoveList badCaptures;
+
+		// scores each capture and moves the losing ones into badCaptures
+		void scoreCaptures();
+		void scoreQuiets();
+		// swaps the best scoring remaining move to moves[current] and returns it
+		Move pickBest();
+		bool isCapture(Move move);
+	};
+}
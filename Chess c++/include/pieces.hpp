@@ -10,10 +10,18 @@ namespace chess
 		PAWN = 0, KNIGHT = 1, BISHOP = 2, ROOK = 3, QUEEN = 4, KING = 5
 	};
 
+	// marks an empty position in Board::mailbox
+	constexpr Type NO_PIECE = 6;
+
 	const enum PieceColour {
 		WHITE = 0, BLACK = 1
 	};
 
+	// the other team's colour, usable in template arguments
+	constexpr PieceColour opposite(PieceColour colour) {
+		return colour == WHITE ? BLACK : WHITE;
+	}
+
 	char getChar(Type type, Colour colour);
 
 	struct Piece {
@@ -6,45 +6,102 @@
 #include "transposition.hpp"
 
 #include <chrono>
+#include <atomic>
 
 
 namespace chess 
 {
+	// deepest ply that keeps killer moves
+	const int MAX_KILLER_PLY = 128;
+	// largest value in SearchThread::history
+	const int MAX_HISTORY = 16384;
+
+	// everything one thread changes while searching, so that threads only share the transposition table
+	struct SearchThread {
+		SearchThread(const Board& rootBoard);
+
+		Board board;
+		Generator generator; // bound to SearchThread::board, so a SearchThread must not be moved
+
+		Move bestRootMove;
+		int bestRootEval;
+		// two quiet moves per ply that most recently caused a beta cutoff
+		Move killers[MAX_KILLER_PLY][2];
+		int nodes;
+		int evalCount;
+		int transposCount;
+		// calls to Bot::shouldFinishSearch since the clock was last read
+		int timeCheckCount;
+		// null moves aren't tried before this ply while verifying a null move cutoff
+		int nullMoveMinPly;
+		// how often each quiet move, by colour, start and end, has caused a beta cutoff rather than being searched before one
+		// weighted by depth
+		int history[2][64][64];
+	};
+
 	class Bot {
 	public:
 		Bot();
-		Bot(double searchTime, bool quies=false);
+		// \param threads: number of threads searching at once (lazy SMP), the extra threads only fill the transposition table
+		Bot(double searchTime, bool quies=false, int threads=1);
 
 		// finds the best move in a given position
 		// uses iterative deepening
 		Move search(Board board);
 
 	private:
-		Move bestRootMove;
-		int bestRootEval;
 		TranspositionTable tt;
-		int transposCount;
 		
 		bool runQuiescence;
+		int threadCount;
 
-		Generator generator;
-		int nodes;
-		int evalCount;
 		int collisions;
 		// stored in milliseconds
 		double maxSearchTime;
 		// time that a search started
-		std::chrono::system_clock::time_point searchStartTime;
+		std::chrono::steady_clock::time_point searchStartTime;
+		// set by whichever thread first sees that time is up
+		std::atomic<bool> stopSearch;
+
+		// reads the clock, setting stopSearch once time is up
+		bool checkTime();
+		// whether the search has been stopped, only reading the clock every TIME_CHECK_INTERVAL calls
+		bool shouldFinishSearch(SearchThread& thread);
+
+		// iterative deepening on a helper thread until the main thread stops the search
+		// \param index: from 1, staggers the depths of the helpers so they search different parts of the tree
+		void helperSearch(SearchThread& thread, int index);
 
-		bool shouldFinishSearch();
+		// searchRoot in a narrow window around the last iteration's eval, widening it until the eval fits
+		void aspirationSearch(SearchThread& thread, int depth);
 
 		// updates bestRoot move and eval
 		// calles negamax up to a certain depth
-		void searchRoot(Board& board, int depth);
+		void searchRoot(SearchThread& thread, int depth, int alpha, int beta);
+
+		// the score of the move just made, from the point of view of the team that made it
+		// \param fullWindow: whether to search (alpha, beta) straight away, otherwise a null window is tried first
+		int principalVariationSearch(SearchThread& thread, int depth, int ply, int alpha, int beta, bool fullWindow);
+
+		// \param ply: distance from the root
+		int negamax(SearchThread& thread, int depth, int ply, int alpha, int beta);
+
+		// null move pruning, passing the turn and searching shallower to see if the position is still above beta
+		// \param score: set to the score to return when the node can be pruned
+		bool tryNullMove(SearchThread& thread, int depth, int ply, int alpha, int beta, int* score);
+
+		// how many plies less to search a late quiet move that has just been made
+		// \param colour: the team that made the move
+		int lateMoveReduction(const SearchThread& thread, Move move, Colour colour, int depth, int ply, int moveCount, bool isPrincipalVariation);
+
+		// \param bonus: positive for the move that caused a cutoff, negative for quiet moves searched before it
+		void updateHistory(SearchThread& thread, Colour colour, Move move, int bonus);
 
-		int negamax(Board& board, int depth, int alpha, int beta);
+		void storeKiller(SearchThread& thread, int ply, Move move);
 
-		int quiescence(Board& board, int depth, int alpha, int beta);
+		// \param depth: 0 on the first quiescence ply, which also searches quiet checks, then negative
+		// \param ply: distance from the root
+		int quiescence(SearchThread& thread, int depth, int ply, int alpha, int beta);
 
 	};
 }
\ No newline at end of file
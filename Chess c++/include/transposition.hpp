@@ -2,6 +2,8 @@
 
 #include "bitboard.hpp"
 
+#include <atomic>
+
 namespace chess
 {
 	enum class NodeType {
@@ -18,14 +20,26 @@ namespace chess
 		NodeType nodeType;
 	};
 
+	// how a TTEntry is stored, as 2 atomic words so that threads can share the table without locking
+	// key is the zobrist xor data, so an entry torn by 2 threads writing at once no longer matches its zobrist
+	struct TTSlot {
+		std::atomic<uint64_t> key;
+		std::atomic<uint64_t> data; // 0-15 = move, 16-47 = value, 48-61 = depth, 62-63 = node type
+	};
+
+	// can be shared by several search threads without locking
 	struct TranspositionTable {
 	public:
 		TranspositionTable(size_t tableSize);
 		~TranspositionTable();
 
-		TTEntry& operator[](Zobrist zobrist);
+		// a copy of the entry where a position would be stored
+		// check its zobrist, it may be for another position or torn by another thread
+		TTEntry operator[](Zobrist zobrist) const;
 
-		bool contains(Zobrist zobrist, int depth, int alpha, int beta);
+		// whether the table has a value for a position that can be used at this depth and window
+		// \param value: set to the entry's value when it can be used
+		bool contains(Zobrist zobrist, int depth, int alpha, int beta, int* value);
 
 		void replace(TTEntry entry);
 
@@ -34,7 +48,7 @@ namespace chess
 		double percentFull();
 	private:
 		size_t size;
-		TTEntry* table;
+		TTSlot* table;
 	};
 }
 
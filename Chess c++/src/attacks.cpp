@@ -0,0 +1,172 @@
+#include "attacks.hpp"
+#include "magics.hpp"
+#include "bitboard.hpp"
+#include "cpu.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>  // avx2
+#define HAS_AVX2_INTRINSIC
+#endif
+
+
+namespace chess
+{
+	namespace attacks
+	{
+		constexpr Bitmap AFile = 0x8080808080808080;
+		constexpr Bitmap BFile = 0x4040404040404040;
+		constexpr Bitmap GFile = 0x0202020202020202;
+		constexpr Bitmap HFile = 0x0101010101010101;
+
+		// a ray direction for the kogge-stone fills
+		struct Direction {
+			int shift;       // positive shifts left (up the board), negative shifts right
+			Bitmap landMask; // positions a single step may land on without wrapping around the board
+		};
+
+		// up, down, towards a and towards h
+		constexpr Direction rookDirections[4] = { {8, ~0ULL}, {-8, ~0ULL}, {1, ~HFile}, {-1, ~AFile} };
+		// up towards a, up towards h, down towards a and down towards h
+		constexpr Direction bishopDirections[4] = { {9, ~HFile}, {7, ~AFile}, {-7, ~HFile}, {-9, ~AFile} };
+
+		constexpr Bitmap shift(Bitmap map, int amount) {
+			return amount > 0 ? map << amount : map >> -amount;
+		}
+
+		// fills every ray from gen in one direction until it hits a non empty position
+		// \return the positions seen along the rays, including the first blocker
+		Bitmap slide(Bitmap gen, Bitmap empty, Direction direction) {
+			int step = direction.shift;
+			Bitmap pro = empty & direction.landMask;
+			gen |= pro & shift(gen, step);
+			pro &= shift(pro, step);
+			gen |= pro & shift(gen, 2 * step);
+			pro &= shift(pro, 2 * step);
+			gen |= pro & shift(gen, 4 * step);
+			return shift(gen, step) & direction.landMask;
+		}
+
+		Bitmap sliderAttacksScalar(Bitmap rookSliders, Bitmap bishopSliders, Bitmap empty) {
+			Bitmap result = 0ULL;
+			for (Direction direction : rookDirections) result |= slide(rookSliders, empty, direction);
+			for (Direction direction : bishopDirections) result |= slide(bishopSliders, empty, direction);
+			return result;
+		}
+
+#if defined(HAS_AVX2_INTRINSIC)
+		// the same fills as slide, with one lane per direction
+		// the rook directions are in lanes 0 and 1, bishop directions in lanes 2 and 3
+		AVX2_FUNCTION Bitmap sliderAttacksAvx2(Bitmap rookSliders, Bitmap bishopSliders, Bitmap empty) {
+			const __m256i step1 = _mm256_setr_epi64x(8, 1, 9, 7);
+			const __m256i step2 = _mm256_slli_epi64(step1, 1);
+			const __m256i step4 = _mm256_slli_epi64(step1, 2);
+			// shifting left moves up the board, right moves down
+			const __m256i leftMask = _mm256_setr_epi64x(~0ULL, ~HFile, ~HFile, ~AFile);
+			const __m256i rightMask = _mm256_setr_epi64x(~0ULL, ~AFile, ~AFile, ~HFile);
+
+			const __m256i sliders = _mm256_setr_epi64x(rookSliders, rookSliders, bishopSliders, bishopSliders);
+			const __m256i emptyMap = _mm256_set1_epi64x(empty);
+
+			__m256i gen = sliders;
+			__m256i pro = _mm256_and_si256(emptyMap, leftMask);
+			gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, step1)));
+			pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, step1));
+			gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, step2)));
+			pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, step2));
+			gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_sllv_epi64(gen, step4)));
+			__m256i result = _mm256_and_si256(_mm256_sllv_epi64(gen, step1), leftMask);
+
+			gen = sliders;
+			pro = _mm256_and_si256(emptyMap, rightMask);
+			gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, step1)));
+			pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, step1));
+			gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, step2)));
+			pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, step2));
+			gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srlv_epi64(gen, step4)));
+			result = _mm256_or_si256(result, _mm256_and_si256(_mm256_srlv_epi64(gen, step1), rightMask));
+
+			// or the four lanes together
+			__m128i half = _mm_or_si128(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1));
+			return (Bitmap)_mm_cvtsi128_si64(half) | (Bitmap)_mm_extract_epi64(half, 1);
+		}
+#endif
+
+		const bool useAvx2 = cpu::hasAvx2();
+
+		Bitmap pawnAttacks(Bitmap pawns, PieceColour colour) {
+			if (colour == WHITE) return ((pawns & ~HFile) << 7) | ((pawns & ~AFile) << 9);
+			else                 return ((pawns & ~HFile) >> 9) | ((pawns & ~AFile) >> 7);
+		}
+
+		Bitmap knightAttacks(Bitmap knights) {
+			Bitmap notA = knights & ~AFile, notH = knights & ~HFile;
+			Bitmap notAB = knights & ~(AFile | BFile), notGH = knights & ~(GFile | HFile);
+			return (notA << 17) | (notH << 15) | (notAB << 10) | (notGH << 6) |
+				(notAB >> 6) | (notGH >> 10) | (notA >> 15) | (notH >> 17);
+		}
+
+		Bitmap kingAttacks(Bitmap kings) {
+			Bitmap sideways = ((kings & ~AFile) << 1) | ((kings & ~HFile) >> 1);
+			Bitmap row = kings | sideways;
+			return sideways | (row << 8) | (row >> 8);
+		}
+
+		Bitmap sliderAttacks(Bitmap rookSliders, Bitmap bishopSliders, Bitmap empty) {
+#if defined(HAS_AVX2_INTRINSIC)
+			if (useAvx2) return sliderAttacksAvx2(rookSliders, bishopSliders, empty);
+#endif
+			return sliderAttacksScalar(rookSliders, bishopSliders, empty);
+		}
+
+		Bitmap blockers(int kingPos, Bitmap teamMap, Bitmap all, Bitmap rookSliders, Bitmap bishopSliders) {
+			Bitmap result = 0ULL;
+			// sliders that would see the king on an empty board
+			Bitmap snipers = (rookPseudoLookup[kingPos][0ULL] & rookSliders) | (bishopPseudoLookup[kingPos][0ULL] & bishopSliders);
+			while (snipers) {
+				int sniperPos = getNextPosition(snipers);
+				Bitmap between = betweenLookup[kingPos][sniperPos] & all;
+				// exactly one piece in the way
+				if (between && !(between & (between - 1))) result |= between & teamMap;
+			}
+			return result;
+		}
+
+		// fills the line and between tables from a position, walking out in every direction
+		constexpr void loadLines(std::array<std::array<Bitmap, 64>, 64>& lines, std::array<std::array<Bitmap, 64>, 64>& between, int pos) {
+			constexpr int rowSteps[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+			constexpr int colSteps[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+			int row = pos / 8, col = pos % 8;
+			for (int direction = 0; direction < 8; direction++) {
+				// the whole line is this direction and its opposite (4 directions on)
+				Bitmap line = bitset[pos];
+				for (int side : { direction, (direction + 4) % 8 }) {
+					for (int r = row + rowSteps[side], c = col + colSteps[side]; 0 <= r && r < 8 && 0 <= c && c < 8; r += rowSteps[side], c += colSteps[side]) {
+						line |= bitset[r * 8 + c];
+					}
+				}
+				Bitmap passed = 0ULL;
+				for (int r = row + rowSteps[direction], c = col + colSteps[direction]; 0 <= r && r < 8 && 0 <= c && c < 8; r += rowSteps[direction], c += colSteps[direction]) {
+					lines[pos][r * 8 + c] = line;
+					between[pos][r * 8 + c] = passed;
+					passed |= bitset[r * 8 + c];
+				}
+			}
+		}
+
+		constexpr std::array<std::array<Bitmap, 64>, 64> loadLineLookup() {
+			std::array<std::array<Bitmap, 64>, 64> lines{}, between{};
+			for (int pos = 0; pos < 64; pos++) loadLines(lines, between, pos);
+			return lines;
+		}
+
+		constexpr std::array<std::array<Bitmap, 64>, 64> loadBetweenLookup() {
+			std::array<std::array<Bitmap, 64>, 64> lines{}, between{};
+			for (int pos = 0; pos < 64; pos++) loadLines(lines, between, pos);
+			return between;
+		}
+	}
+
+	// generated at compile time
+	constexpr std::array<std::array<Bitmap, 64>, 64> lineLookup = attacks::loadLineLookup();
+	constexpr std::array<std::array<Bitmap, 64>, 64> betweenLookup = attacks::loadBetweenLookup();
+}
@@ -1,22 +1,28 @@
 #include "bitboard.hpp"
+#include "magics.hpp"
+#include "attacks.hpp"
 
 #include <iostream>
 #include <algorithm>
 #include <string>
 #include <vector>
-#include <map>
+#include <string_view>
+#include <charconv>
 #include <stdexcept>
-#include <cstdlib>
+#include <type_traits>
+#include <bit>
+#include <limits>
 
 
 namespace chess
 {
 
-	const static std::string startingFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w QKqk - 0 1";
+	constexpr std::string_view startingFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w QKqk - 0 1";
 
 	// positions where each rook should be when they can still castle
 	const Bitmap rightStartingRooks[2] = { 1ULL, 1ULL << 56 };
 	const Bitmap leftStartingRooks[2] = { 1ULL << 7, 1ULL << 63 };
+	const Bitmap startingKings[2] = { 1ULL << 3, 1ULL << 59 };
 
 	
 
@@ -69,37 +75,147 @@ namespace chess
 		return getSinglePosition(positionMap);
 	}
 
-	Zobrist makeRandomZobrist() {
-		return
-			((Zobrist)std::rand() & 0xffULL) |
-			(((Zobrist)std::rand() & 0xffULL) << 8) |
-			(((Zobrist)std::rand() & 0xffULL) << 16) |
-			(((Zobrist)std::rand() & 0xffULL) << 24) |
-			(((Zobrist)std::rand() & 0xffULL) << 32) |
-			(((Zobrist)std::rand() & 0xffULL) << 40) |
-			(((Zobrist)std::rand() & 0xffULL) << 48) |
-			(((Zobrist)std::rand() & 0xffULL) << 56);
-	}
-
-	Zobrist zobristPieces[2][6][64];
-	Zobrist zobristTeam;
-	Zobrist zobristRightCastles[2];
-	Zobrist zobristLeftCastles[2];
-	Zobrist zobristEp[8];
-
-	struct ZobristLoader {
-		ZobristLoader() {
-			for (int i = 0; i < 2 * 6 * 64; i++) zobristPieces[i % 2][(i / 2) % 6][(i / 2 / 6) % 64] = makeRandomZobrist();
-			zobristTeam = makeRandomZobrist();
-			zobristRightCastles[WHITE] = makeRandomZobrist();
-			zobristRightCastles[BLACK] = makeRandomZobrist();
-			zobristLeftCastles[WHITE] = makeRandomZobrist();
-			zobristLeftCastles[BLACK] = makeRandomZobrist();
-			for (int i = 0; i < 8; i++) zobristEp[i] = makeRandomZobrist();
+	// splitmix64, a small fast generator with well mixed 64 bit output
+	// seeded with a fixed value so the keys are the same in every build
+	struct ZobristRandom {
+		uint64_t state = 0x9e3779b97f4a7c15;
+
+		constexpr Zobrist nextZobrist() {
+			state += 0x9e3779b97f4a7c15;
+			uint64_t z = state;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			return z ^ (z >> 31);
 		}
 	};
 
-	ZobristLoader zobristLoader;
+	struct ZobristKeys {
+		Zobrist pieces[2][6][64];
+		Zobrist team;
+		Zobrist rightCastles[2];
+		Zobrist leftCastles[2];
+		Zobrist ep[8];
+	};
+
+	constexpr ZobristKeys loadZobristKeys() {
+		ZobristRandom random;
+		ZobristKeys keys{};
+		for (int i = 0; i < 2 * 6 * 64; i++) keys.pieces[i % 2][(i / 2) % 6][(i / 2 / 6) % 64] = random.nextZobrist();
+		keys.team = random.nextZobrist();
+		keys.rightCastles[WHITE] = random.nextZobrist();
+		keys.rightCastles[BLACK] = random.nextZobrist();
+		keys.leftCastles[WHITE] = random.nextZobrist();
+		keys.leftCastles[BLACK] = random.nextZobrist();
+		for (int i = 0; i < 8; i++) keys.ep[i] = random.nextZobrist();
+		return keys;
+	}
+
+	// generated at compile time
+	constexpr ZobristKeys zobristKeys = loadZobristKeys();
+
+	constexpr auto& zobristPieces = zobristKeys.pieces;
+	constexpr const Zobrist& zobristTeam = zobristKeys.team;
+	constexpr auto& zobristRightCastles = zobristKeys.rightCastles;
+	constexpr auto& zobristLeftCastles = zobristKeys.leftCastles;
+	constexpr auto& zobristEp = zobristKeys.ep;
+
+	// whether a piece can move between two positions on an empty board
+	constexpr bool canReach(Type piece, int position1, int position2) {
+		int rowDistance = position1 / 8 - position2 / 8, colDistance = position1 % 8 - position2 % 8;
+		if (rowDistance < 0) rowDistance = -rowDistance;
+		if (colDistance < 0) colDistance = -colDistance;
+		bool straight = rowDistance == 0 || colDistance == 0;
+		bool diagonal = rowDistance == colDistance;
+		switch (piece) {
+		case KNIGHT: return (rowDistance == 1 && colDistance == 2) || (rowDistance == 2 && colDistance == 1);
+		case BISHOP: return diagonal;
+		case ROOK:   return straight;
+		case QUEEN:  return straight || diagonal;
+		case KING:   return rowDistance <= 1 && colDistance <= 1;
+		default:     return false;
+		}
+	}
+
+	// the change in zobrist key of every reversible move (no pawns or captures) in a cuckoo hash table
+	// lets Board::hasUpcomingRepetition find the one move that repeats a past position
+	constexpr size_t CUCKOO_SIZE = 8192;
+	struct CuckooTable {
+		std::array<Zobrist, CUCKOO_SIZE> keys;
+		std::array<Move, CUCKOO_SIZE> moves;
+	};
+
+	constexpr size_t cuckooHash1(Zobrist key) { return key & (CUCKOO_SIZE - 1); }
+	constexpr size_t cuckooHash2(Zobrist key) { return (key >> 16) & (CUCKOO_SIZE - 1); }
+
+	constexpr CuckooTable loadCuckooTable() {
+		CuckooTable table{};
+		for (int team = 0; team <= 1; team++) {
+			for (Type piece = KNIGHT; piece <= KING; piece++) {
+				for (int position1 = 0; position1 < 64; position1++) {
+					for (int position2 = position1 + 1; position2 < 64; position2++) {
+						if (!canReach(piece, position1, position2)) continue;
+
+						Zobrist key = zobristPieces[team][piece][position1] ^ zobristPieces[team][piece][position2] ^ zobristTeam;
+						Move move = makeMove(position1, position2);
+						size_t index = cuckooHash1(key);
+						// keep kicking out whatever is in the way to its other slot until an empty one is found
+						while (true) {
+							std::swap(table.keys[index], key);
+							std::swap(table.moves[index], move);
+							if (move == NULL_MOVE) break;
+							index = index == cuckooHash1(key) ? cuckooHash2(key) : cuckooHash1(key);
+						}
+					}
+				}
+			}
+		}
+		return table;
+	}
+
+	// generated at compile time
+	constexpr CuckooTable cuckooTable = loadCuckooTable();
+
+	static_assert(std::is_trivially_copyable_v<Position>, "Position is copied for copy-make");
+	static_assert(std::is_trivially_copyable_v<PackedPosition> && sizeof(PackedPosition) == 32, "PackedPosition is stored as raw bytes");
+
+	StateHistory::StateHistory() {
+		count = 0;
+	}
+
+	StateHistory::StateHistory(const StateHistory& other) {
+		*this = other;
+	}
+
+	StateHistory& StateHistory::operator=(const StateHistory& other) {
+		count = other.count;
+		size_t used = std::min(count, HISTORY_SIZE);
+		for (size_t i = count - used; i < count; i++) {
+			states[i % HISTORY_SIZE] = other.states[i % HISTORY_SIZE];
+		}
+		return *this;
+	}
+
+	void StateHistory::push(const BoardState& state) {
+		states[count % HISTORY_SIZE] = state;
+		count++;
+	}
+
+	BoardState StateHistory::pop() {
+		count--;
+		return states[count % HISTORY_SIZE];
+	}
+
+	const BoardState& StateHistory::top() const {
+		return states[(count - 1) % HISTORY_SIZE];
+	}
+
+	const BoardState& StateHistory::fromTop(size_t index) const {
+		return states[(count - 1 - index) % HISTORY_SIZE];
+	}
+
+	size_t StateHistory::size() const {
+		return std::min(count, HISTORY_SIZE);
+	}
 
 	void Board::setPositions(Bitmap wp, Bitmap wn, Bitmap wb, Bitmap wr, Bitmap wq, Bitmap wk, Bitmap bp, Bitmap bn, Bitmap bb, Bitmap br, Bitmap bq, Bitmap bk) {
 		Bitmap newPositions[2][6] = { {wp, wn, wb, wr, wq, wk}, {bp, bn, bb, br, bq, bk} };
@@ -107,6 +223,15 @@ namespace chess
 		std::copy(newPositions[1], newPositions[1] + 6, positions[1]);
 
 		updateTeamPositions();
+
+		for (int pos = 0; pos < 64; pos++) {
+			mailbox[pos] = NO_PIECE;
+			for (int team = 0; team <= 1; team++) {
+				for (Type piece = PAWN; piece <= KING; piece++) {
+					if (positions[team][piece] & bitset[pos]) mailbox[pos] = piece;
+				}
+			}
+		}
 	}
 
 	void Board::setGameState(Bitmap ep, bool wlc, bool wrc, bool blc, bool brc, int moveCount, int hm, Colour clr) {
@@ -120,9 +245,16 @@ namespace chess
 
 	Board::Board(Bitmap wp, Bitmap wn, Bitmap wb, Bitmap wr, Bitmap wq, Bitmap wk, Bitmap bp, Bitmap bn, Bitmap bb, Bitmap br, Bitmap bq, Bitmap bk, Bitmap ep, bool wlc, bool wrc, bool blc, bool brc, int move_count, int hm, Colour colour)
 	{
+		initPextLookups();
 		setPositions(wp, wn, wb, wr, wq, wk, bp, bn, bb, br, bq, bk);
 		setGameState(ep, wlc, wrc, blc, brc, move_count, hm, colour);
+		pliesFromNull = 0;
 		loadZobrist();
+		loadCheckInfo();
+	}
+
+	Board::Board(const Position& position) : Position(position) {
+		initPextLookups();
 	}
 
 
@@ -141,68 +273,248 @@ namespace chess
 		*this = Board::fromFen(startingFen);
 	}
 
-	Board Board::fromFen(std::string fen)
-	{
-		std::vector<std::string> data = { "" };
-		for (char c : fen) {
-			if (c == ' ') data.push_back("");
-			else data.back() += c;
+	// the next space separated field of a FEN, removing it from fen
+	// returns an empty view when there are no fields left
+	static std::string_view nextFenField(std::string_view& fen) {
+		size_t start = fen.find_first_not_of(' ');
+		if (start == std::string_view::npos) {
+			fen = {};
+			return {};
 		}
-		while (data.size() < 6) data.push_back("-");
-
-		std::string layout = data[0];
-		std::string clr = data[1];
-		std::string castles = data[2];
-		std::string pawnMove = data[3];
-		std::string halfMove = data[4];
-		std::string fullMove = data[5];
+		fen.remove_prefix(start);
+		size_t length = std::min(fen.find(' '), fen.size());
+		std::string_view field = fen.substr(0, length);
+		fen.remove_prefix(length);
+		return field;
+	}
 
-		std::map<char, int> colourValues{ {'P', 0}, {'N', 1}, {'B', 2}, {'R', 3}, {'Q', 4}, {'K', 5},
-										  {'p', 6}, {'n', 7}, {'b', 8}, {'r', 9}, {'q', 10}, {'k', 11} };
+	// reads a move count field, where an omitted field is given as "-" or left empty
+	static int parseFenCount(std::string_view field, int fallback) {
+		if (field.empty() || field == "-") return fallback;
+		int value;
+		auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+		if (error != std::errc() || end != field.data() + field.size() || value < 0) {
+			throw std::invalid_argument("FEN move counts must be non-negative integers");
+		}
+		return value;
+	}
 
-		// getting positions of pieces
-		Bitmap pos[12]{ 0ULL };
-		Bitmap position = 1ULL << 63;
+	Board Board::fromFen(std::string_view fen)
+	{
+		std::string_view layout = nextFenField(fen);
+		std::string_view clr = nextFenField(fen);
+		std::string_view castles = nextFenField(fen);
+		std::string_view pawnMove = nextFenField(fen);
+		std::string_view halfMove = nextFenField(fen);
+		std::string_view fullMove = nextFenField(fen);
+		if (pawnMove.empty()) throw std::invalid_argument("FEN must have the layout, colour, castling and en passant fields");
+		if (!nextFenField(fen).empty()) throw std::invalid_argument("FEN has too many fields");
+
+		// getting positions of pieces, from a8 to h1
+		Bitmap pos[2][6]{ 0ULL };
+		int row = 7, col = 0;
 		for (char c : layout) {
-			if (c == '/') continue;
-			else if ('0' < c && c < '9') position >>= ((int)c - (int)'0');
+			if (c == '/') {
+				if (col != 8 || row == 0) throw std::invalid_argument("FEN rows must each have 8 positions");
+				row--;
+				col = 0;
+			}
+			else if ('0' < c && c < '9') {
+				col += c - '0';
+				if (col > 8) throw std::invalid_argument("FEN rows must each have 8 positions");
+			}
 			else {
-				int pieceVal = colourValues[c];
-				pos[pieceVal] |= position;
-				position >>= 1;
+				Colour pieceColour = ('a' <= c && c <= 'z') ? BLACK : WHITE;
+				char upper = pieceColour == BLACK ? c - ('a' - 'A') : c;
+				const char* letter = std::find(pieceLetters, pieceLetters + 6, upper);
+				if (letter == pieceLetters + 6) throw std::invalid_argument("FEN has an unknown piece letter");
+				if (col >= 8) throw std::invalid_argument("FEN rows must each have 8 positions");
+				pos[pieceColour][letter - pieceLetters] |= bitset[row * 8 + 7 - col];
+				col++;
 			}
 		}
+		if (row != 0 || col != 8) throw std::invalid_argument("FEN must have 8 rows");
+		if (std::popcount(pos[WHITE][KING]) != 1 || std::popcount(pos[BLACK][KING]) != 1) {
+			throw std::invalid_argument("FEN must have one king for each team");
+		}
 
 		// colour
 		Colour initColour;
 		if (clr == "w") initColour = WHITE;
-		else initColour = BLACK;
+		else if (clr == "b") initColour = BLACK;
+		else throw std::invalid_argument("FEN colour must be w or b");
+
 		// castling
-		bool wlc = std::find(castles.begin(), castles.end(), 'Q') != castles.end();
-		bool wrc = std::find(castles.begin(), castles.end(), 'K') != castles.end();
-		bool blc = std::find(castles.begin(), castles.end(), 'q') != castles.end();
-		bool brc = std::find(castles.begin(), castles.end(), 'k') != castles.end();
-		// en passant bitmap
+		bool wlc = false, wrc = false, blc = false, brc = false;
+		if (castles != "-") {
+			for (char c : castles) {
+				switch (c) {
+				case 'Q': wlc = true; break;
+				case 'K': wrc = true; break;
+				case 'q': blc = true; break;
+				case 'k': brc = true; break;
+				default: throw std::invalid_argument("FEN castling rights must be - or from KQkq");
+				}
+			}
+		}
+		for (Colour c : { WHITE, BLACK }) {
+			bool kingHome = pos[c][KING] & startingKings[c];
+			bool& left = c == WHITE ? wlc : blc;
+			bool& right = c == WHITE ? wrc : brc;
+			if ((left && !(kingHome && (pos[c][ROOK] & leftStartingRooks[c])))
+				|| (right && !(kingHome && (pos[c][ROOK] & rightStartingRooks[c])))) {
+				throw std::invalid_argument("FEN castling rights need the king and rook on their starting positions");
+			}
+		}
+
+		// en passant bitmap, the position a pawn passed over when moving 2 forwards
 		Bitmap ep = 0;
 		if (pawnMove != "-") {
-			int column = std::distance(columnLetters, std::find(columnLetters, columnLetters + 8, pawnMove[0]));
-			int row = 8 * (pawnMove[1] - '0' - 1);
-			int lastMoveEnd = (8 - column) + (8 * row) - 1;
-			ep = 1 < lastMoveEnd;
-			if (initColour == WHITE) ep >>= 8;
-			else ep <<= 8;
+			char epRow = initColour == WHITE ? '6' : '3';
+			if (pawnMove.size() != 2 || pawnMove[0] < 'a' || pawnMove[0] > 'h' || pawnMove[1] != epRow) {
+				throw std::invalid_argument("FEN en passant position must be - or on the row behind a pawn that has just moved");
+			}
+			ep = bitset[(pawnMove[1] - '1') * 8 + 7 - (pawnMove[0] - 'a')];
 		}
 
-		// half and full move counts
-		int hm = 0;
-		if (halfMove != "-") hm = std::stoi(halfMove);
-		int moves = initColour;
-		if (fullMove != "-") moves = std::stoi(fullMove);
+		// half and full move counts, Board::currentMove counts plies from 0
+		int hm = parseFenCount(halfMove, 0);
+		int fullMoves = std::max(parseFenCount(fullMove, 1), 1);
+		if (fullMoves - 1 > std::numeric_limits<int>::max() / 2) {
+			throw std::invalid_argument("FEN full move count is too large");
+		}
+		int moves = (fullMoves - 1) * 2 + initColour;
 
-		return Board(pos[0], pos[1], pos[2], pos[3], pos[4], pos[5], pos[6], pos[7], pos[8], pos[9], pos[10], pos[11], ep,
+		return Board(pos[WHITE][PAWN], pos[WHITE][KNIGHT], pos[WHITE][BISHOP], pos[WHITE][ROOK], pos[WHITE][QUEEN], pos[WHITE][KING],
+			pos[BLACK][PAWN], pos[BLACK][KNIGHT], pos[BLACK][BISHOP], pos[BLACK][ROOK], pos[BLACK][QUEEN], pos[BLACK][KING], ep,
 			wlc, wrc, blc, brc, moves, hm, initColour);
 	}
 
+	std::string Board::toFen() const
+	{
+		std::string out;
+		out.reserve(90);
+
+		for (int row = 7; row >= 0; row--) {
+			int empty = 0;
+			for (int col = 0; col < 8; col++) {
+				int position = row * 8 + 7 - col;
+				if (mailbox[position] == NO_PIECE) {
+					empty++;
+					continue;
+				}
+				if (empty) out += (char)('0' + empty);
+				empty = 0;
+				char letter = pieceLetters[mailbox[position]];
+				if (teamMaps[BLACK] & bitset[position]) letter += 'a' - 'A';
+				out += letter;
+			}
+			if (empty) out += (char)('0' + empty);
+			if (row) out += '/';
+		}
+
+		out += colour == WHITE ? " w " : " b ";
+
+		if (rightCastles[WHITE]) out += 'K';
+		if (leftCastles[WHITE]) out += 'Q';
+		if (rightCastles[BLACK]) out += 'k';
+		if (leftCastles[BLACK]) out += 'q';
+		if (!rightCastles[WHITE] && !leftCastles[WHITE] && !rightCastles[BLACK] && !leftCastles[BLACK]) out += '-';
+
+		out += ' ';
+		if (epMap) {
+			int position = getSinglePosition(epMap);
+			out += columnLetters[7 - position % 8];
+			out += (char)('1' + position / 8);
+		}
+		else out += '-';
+
+		// large enough for any int, so std::to_chars can't fail
+		char count[12];
+		out += ' ';
+		out.append(count, std::to_chars(count, count + sizeof(count), halfMoves).ptr);
+		out += ' ';
+		out.append(count, std::to_chars(count, count + sizeof(count), currentMove / 2 + 1).ptr);
+		return out;
+	}
+
+	Board Board::fromPacked(const PackedPosition& packed)
+	{
+		if (std::popcount(packed.occupancy) > 32) throw std::invalid_argument("Packed position has more than 32 pieces");
+
+		Colour initColour = packed.state & 1;
+		if (packed.currentMove > (uint32_t)std::numeric_limits<int>::max() || (packed.currentMove % 2 == 1) != initColour) {
+			throw std::invalid_argument("Packed position's move count must fit an int and be odd exactly when black is to move");
+		}
+
+		// a single pass over the pieces fills the bitmaps, mailbox and hashes together
+		Position position{};
+		std::fill(position.mailbox, position.mailbox + 64, NO_PIECE);
+		int pieceCounts[2][6]{ 0 };
+		Bitmap occupancy = packed.occupancy;
+		for (int index = 0; occupancy; index++) {
+			int pos = getNextPosition(occupancy);
+			int code = (packed.pieces[index / 2] >> (index % 2 * 4)) & 0xf;
+			if (code >= 12) throw std::invalid_argument("Packed position has an unknown piece code");
+			Colour team = code / 6;
+			Type piece = code % 6;
+			position.positions[team][piece] |= bitset[pos];
+			position.teamMaps[team] |= bitset[pos];
+			position.mailbox[pos] = piece;
+			position.zobrist ^= zobristPieces[team][piece][pos];
+			if (piece == PAWN) position.pawnKey ^= zobristPieces[team][piece][pos];
+			// one key for each piece of the type, the first uses index 0 (as in loadZobrist)
+			position.materialKey ^= zobristPieces[team][piece][pieceCounts[team][piece]++];
+		}
+		position.all = packed.occupancy;
+		if (std::popcount(position.positions[WHITE][KING]) != 1 || std::popcount(position.positions[BLACK][KING]) != 1) {
+			throw std::invalid_argument("Packed position must have one king for each team");
+		}
+
+		if (packed.epColumn) {
+			if (packed.epColumn > 8) throw std::invalid_argument("Packed position has an unknown en passant column");
+			int row = initColour == WHITE ? 5 : 2;
+			position.epMap = bitset[row * 8 + 8 - packed.epColumn];
+			position.zobrist ^= zobristEp[(8 - packed.epColumn) % 8];
+		}
+
+		position.leftCastles = { (bool)(packed.state & 2), (bool)(packed.state & 8) };
+		position.rightCastles = { (bool)(packed.state & 4), (bool)(packed.state & 16) };
+		position.zobrist ^= zobristRightCastles[WHITE] * position.rightCastles[WHITE];
+		position.zobrist ^= zobristRightCastles[BLACK] * position.rightCastles[BLACK];
+		position.zobrist ^= zobristLeftCastles[WHITE] * position.leftCastles[WHITE];
+		position.zobrist ^= zobristLeftCastles[BLACK] * position.leftCastles[BLACK];
+
+		position.colour = initColour;
+		position.zobrist ^= zobristTeam * initColour;
+		position.currentMove = (int)packed.currentMove;
+		position.halfMoves = packed.halfMoves;
+		position.pliesFromNull = 0;
+
+		Board board(position);
+		board.loadCheckInfo();
+		return board;
+	}
+
+	PackedPosition Board::toPacked() const
+	{
+		PackedPosition packed{};
+		packed.occupancy = all;
+
+		Bitmap occupancy = all;
+		for (int index = 0; occupancy; index++) {
+			int position = getNextPosition(occupancy);
+			int code = mailbox[position] + ((teamMaps[BLACK] & bitset[position]) ? 6 : 0);
+			packed.pieces[index / 2] |= code << (index % 2 * 4);
+		}
+
+		packed.state = colour | leftCastles[WHITE] << 1 | rightCastles[WHITE] << 2 | leftCastles[BLACK] << 3 | rightCastles[BLACK] << 4;
+		packed.epColumn = epMap ? 8 - getSinglePosition(epMap) % 8 : 0;
+		packed.halfMoves = std::min(halfMoves, 255);
+		packed.currentMove = currentMove;
+		return packed;
+	}
+
 	std::string chess::Board::toString() const
 	{
 		Bitmap position = 1ULL << 63;
@@ -229,60 +541,101 @@ namespace chess
 		return out;
 	}
 
-	void chess::Board::makeMove(Move move) {
+	void Board::makeMove(Move move) {
+		if (colour == WHITE) makeMove<WHITE>(move);
+		else                 makeMove<BLACK>(move);
+	}
+
+	void Board::unmakeMove(Move move) {
+		// the team that made the move is the one not currently moving
+		if (colour == BLACK) unmakeMove<WHITE>(move);
+		else                 unmakeMove<BLACK>(move);
+	}
+
+	template <PieceColour us>
+	void Board::makeMove(Move move) {
+		constexpr PieceColour them = opposite(us);
+		bool capture = (bitset[getEnd(move)] & teamMaps[them]);
+		Type endPieceType = capture ? mailbox[getEnd(move)] : 0;
+
+		// saved before the move as taking a piece could affect castling rules
+		BoardState currentState = { currentMove, halfMoves,
+			leftCastles[WHITE], rightCastles[WHITE], leftCastles[BLACK], rightCastles[BLACK],
+			epMap, capture, endPieceType, zobrist, pawnKey, materialKey, checkers, pinned, pliesFromNull};
+
+		applyMove<us>(move);
+		pastStates.push(currentState);
+	}
+
+	void Board::makeNullMove() {
+		BoardState currentState = { currentMove, halfMoves,
+			leftCastles[WHITE], rightCastles[WHITE], leftCastles[BLACK], rightCastles[BLACK],
+			epMap, false, 0, zobrist, pawnKey, materialKey, checkers, pinned, pliesFromNull};
+		pastStates.push(currentState);
+
+		// the en passant chance is lost as the pawn was not taken straight away
+		if (epMap) {
+			zobrist ^= zobristEp[getSinglePosition(epMap) % 8];
+			epMap = 0;
+		}
+		halfMoves++;
+		incrementGameState();
+		pliesFromNull = 0;
+		loadCheckInfo();
+	}
+
+	void Board::unmakeNullMove() {
+		BoardState state = pastStates.pop();
+		setGameState(state.epMap, state.wlc, state.wrc, state.blc, state.brc, state.moveCount, state.halfMoveCount, !colour);
+		zobrist = state.zobrist;
+		checkers = state.checkers;
+		pinned = state.pinned;
+		pliesFromNull = state.pliesFromNull;
+	}
+
+	Position Position::afterMove(Move move) const {
+		if (colour == WHITE) return afterMove<WHITE>(move);
+		else                 return afterMove<BLACK>(move);
+	}
+
+	template <PieceColour us>
+	Position Position::afterMove(Move move) const {
+		Position next = *this;
+		next.applyMove<us>(move);
+		return next;
+	}
+
+	template <PieceColour us>
+	void Position::applyMove(Move move) {
+		constexpr PieceColour them = opposite(us);
 		Bitmap start = bitset[getStart(move)];
 		Bitmap end = bitset[getEnd(move)];
 		Flag flag = getFlag(move);
 
-		if (!(bool)(start & teamMaps[colour])) {
+		if (!(bool)(start & teamMaps[us])) {
 			throw std::invalid_argument("Cannot move from an empty square");
 		}
 	
-		bool capture = (end & teamMaps[1 - colour]);
-		Type endPieceType = 0;
-		if (capture) {
-			// search for taken piece
-			for (Bitmap posmap : positions[!colour]) {
-				if (posmap & end) {
-					break;
-				}
-				endPieceType++;
-			}
-		}
-
-		// update past states stack
-		BoardState currentState = { currentMove, halfMoves,
-			leftCastles[WHITE], rightCastles[WHITE], leftCastles[BLACK], rightCastles[BLACK],
-			epMap, capture, endPieceType, zobrist};
-
-		pastStates.push(currentState);
+		bool capture = (end & teamMaps[them]);
+		Type endPieceType = capture ? mailbox[getEnd(move)] : 0;
 
-		// this is done after adding to the state as taking the piece could affect castling rules
 		if (capture) {
-			takePiece(end, endPieceType);
+			takePiece<us>(end, endPieceType);
 		}
 
-		// search for moved piece
-		Type startPieceType = PAWN;
-		for (Bitmap posMap : positions[colour]) {
-			if (posMap & start) {
-				break;
-			}
-			startPieceType++;
-		}
+		Type startPieceType = mailbox[getStart(move)];
 
 		// move piece
 		switch (flag) {
-		case Flag::NONE:       movePieceDefault(start, end, startPieceType); break;
-		case Flag::EN_PASSANT: movePieceEp(start, end); break;
-		case Flag::PROMOTION:  movePiecePromotion(start, end, getPromotion(move)); break;
-		case Flag::CASTLE:     movePieceCastle(start, end); break;
+		case Flag::NONE:       movePieceDefault<us>(start, end, startPieceType); break;
+		case Flag::EN_PASSANT: movePieceEp<us>(start, end); break;
+		case Flag::PROMOTION:  movePiecePromotion<us>(start, end, getPromotion(move)); break;
+		case Flag::CASTLE:     movePieceCastle<us>(start, end); break;
 		}
 
-		// update halfMoves
-		if (!capture && flag != Flag::EN_PASSANT) {
-			halfMoves = 0;
-		}
+		// update halfMoves, the plies since the last capture or pawn move
+		if (capture || startPieceType == PAWN) halfMoves = 0;
+		else                                   halfMoves++;
 
 		// update epMap
 		if (epMap) {
@@ -290,52 +643,76 @@ namespace chess
 			epMap = 0;
 		}
 		if (startPieceType == PAWN) {
-			updateEpMap(start, end);
+			updateEpMap<us>(start, end);
 		}
 
 		// remove castle rights after a king move
 		if (startPieceType == KING) {
-			rightCastles[colour] = false;
-			leftCastles[colour] = false;
+			if (rightCastles[us]) zobrist ^= zobristRightCastles[us];
+			if (leftCastles[us]) zobrist ^= zobristLeftCastles[us];
+			rightCastles[us] = false;
+			leftCastles[us] = false;
 		}
-		updateTeamPositions();
 		incrementGameState();
+		loadCheckInfo<them>();
 	}
 
-	void chess::Board::movePieceDefault(Bitmap start, Bitmap end, Type pieceType) {
-		positions[colour][pieceType] ^= start | end;
+	template <PieceColour us>
+	void Position::movePieceDefault(Bitmap start, Bitmap end, Type pieceType) {
+		int startPos = getSinglePosition(start), endPos = getSinglePosition(end);
+		positions[us][pieceType] ^= start | end;
+		teamMaps[us] ^= start | end;
+		all ^= start | end;
+		mailbox[startPos] = NO_PIECE;
+		mailbox[endPos] = pieceType;
 		
-		zobrist ^= zobristPieces[colour][pieceType][getSinglePosition(start)];
-		zobrist ^= zobristPieces[colour][pieceType][getSinglePosition(end)];
+		zobrist ^= zobristPieces[us][pieceType][startPos];
+		zobrist ^= zobristPieces[us][pieceType][endPos];
+		if (pieceType == PAWN) {
+			pawnKey ^= zobristPieces[us][PAWN][startPos];
+			pawnKey ^= zobristPieces[us][PAWN][endPos];
+		}
 
 		if (pieceType == ROOK) {
-			removeSingleCastle(start, colour);
+			removeSingleCastle(start, us);
 		}
 	}
 
-	void chess::Board::movePieceEp(Bitmap start, Bitmap end) {
-		movePieceDefault(start, end, PAWN);
+	template <PieceColour us>
+	void Position::movePieceEp(Bitmap start, Bitmap end) {
+		movePieceDefault<us>(start, end, PAWN);
 		// position of the piece taken
 		Bitmap epPos;
-		if (colour == WHITE) epPos = end >> 8;
-		else                 epPos = end << 8;
+		if constexpr (us == WHITE) epPos = end >> 8;
+		else                           epPos = end << 8;
 
-		takePiece(epPos, PAWN);
+		takePiece<us>(epPos, PAWN);
 	}
 
-	void chess::Board::movePiecePromotion(Bitmap start, Bitmap end, Type promotionType) {
-		positions[colour][PAWN] ^= start;
-		positions[colour][promotionType] |= end;
-
-		zobrist ^= zobristPieces[colour][PAWN][getSinglePosition(start)];
-		zobrist ^= zobristPieces[colour][promotionType][getSinglePosition(end)];
+	template <PieceColour us>
+	void Position::movePiecePromotion(Bitmap start, Bitmap end, Type promotionType) {
+		int startPos = getSinglePosition(start), endPos = getSinglePosition(end);
+		positions[us][PAWN] ^= start;
+		positions[us][promotionType] |= end;
+		teamMaps[us] ^= start | end;
+		all ^= start | end;
+		mailbox[startPos] = NO_PIECE;
+		mailbox[endPos] = promotionType;
+
+		zobrist ^= zobristPieces[us][PAWN][startPos];
+		zobrist ^= zobristPieces[us][promotionType][endPos];
+		pawnKey ^= zobristPieces[us][PAWN][startPos];
+		// the material key uses the piece count in place of a position
+		materialKey ^= zobristPieces[us][PAWN][std::popcount(positions[us][PAWN])];
+		materialKey ^= zobristPieces[us][promotionType][std::popcount(positions[us][promotionType]) - 1];
 	}
 
-	void chess::Board::movePieceCastle(Bitmap start, Bitmap end) {
-		movePieceDefault(start, end, KING);
+	template <PieceColour us>
+	void Position::movePieceCastle(Bitmap start, Bitmap end) {
+		movePieceDefault<us>(start, end, KING);
 
 		Bitmap rstart, rend;
-		if (colour == WHITE) {
+		if constexpr (us == WHITE) {
 			if (end < start) { // castle right
 				rstart = 1;
 				rend = end << 1;
@@ -355,20 +732,29 @@ namespace chess
 				rend = end >> 1;
 			}
 		}
-		movePieceDefault(rstart, rend, ROOK);
+		movePieceDefault<us>(rstart, rend, ROOK);
 
 	}
 
-	void chess::Board::takePiece(Bitmap position, Type pieceType) {
-		positions[!colour][pieceType] ^= position;
+	template <PieceColour us>
+	void Position::takePiece(Bitmap position, Type pieceType) {
+		constexpr PieceColour them = opposite(us);
+		int pos = getSinglePosition(position);
+		positions[them][pieceType] ^= position;
+		teamMaps[them] ^= position;
+		all ^= position;
+		mailbox[pos] = NO_PIECE;
 
-		zobrist ^= zobristPieces[!colour][pieceType][getSinglePosition(position)];
+		zobrist ^= zobristPieces[them][pieceType][pos];
+		if (pieceType == PAWN) pawnKey ^= zobristPieces[them][PAWN][pos];
+		materialKey ^= zobristPieces[them][pieceType][std::popcount(positions[them][pieceType])];
 
-		if (pieceType == ROOK) removeSingleCastle(position, 1 - colour);
+		if (pieceType == ROOK) removeSingleCastle(position, them);
 	}
 
-	void chess::Board::updateEpMap(Bitmap start, Bitmap end) {
-		if (colour == WHITE) {
+	template <PieceColour us>
+	void Position::updateEpMap(Bitmap start, Bitmap end) {
+		if constexpr (us == WHITE) {
 			// end is not far enough away to have been doubled
 			if ((end >> 10) < start) return;
 			epMap = end >> 8;
@@ -381,14 +767,14 @@ namespace chess
 		zobrist ^= zobristEp[getSinglePosition(epMap) % 8];
 	}
 
-	void chess::Board::incrementGameState() {
+	void Position::incrementGameState() {
 		currentMove++;
-		halfMoves++;
+		pliesFromNull++;
 		colour = !colour;
 		zobrist ^= zobristTeam;
 	}
 
-	void chess::Board::updateTeamPositions() {
+	void Position::updateTeamPositions() {
 		teamMaps[WHITE] = 0;
 		for (Bitmap posmap : positions[WHITE]) {
 			teamMaps[WHITE] |= posmap;
@@ -400,7 +786,7 @@ namespace chess
 		all = teamMaps[0] | teamMaps[1];
 	}
 
-	void chess::Board::removeSingleCastle(Bitmap rookPosition, Colour clr) {
+	void Position::removeSingleCastle(Bitmap rookPosition, Colour clr) {
 		if ((rookPosition & leftStartingRooks[clr]) && leftCastles[clr]) {
 			leftCastles[clr] = false;
 			zobrist ^= zobristLeftCastles[clr];
@@ -411,11 +797,12 @@ namespace chess
 		}
 	}
 
-	void chess::Board::unmakeMove(Move move) {
-		BoardState state = pastStates.top();
-		pastStates.pop();
+	template <PieceColour us>
+	void Board::unmakeMove(Move move) {
+		constexpr PieceColour them = opposite(us);
+		BoardState state = pastStates.pop();
 
-		setGameState(state.epMap, state.wlc, state.wrc, state.blc, state.brc, state.moveCount, state.halfMoveCount, !colour);
+		setGameState(state.epMap, state.wlc, state.wrc, state.blc, state.brc, state.moveCount, state.halfMoveCount, us);
 
 		Bitmap start = bitset[getStart(move)];
 		Bitmap end = bitset[getEnd(move)];
@@ -423,48 +810,100 @@ namespace chess
 
 		
 		if (flag == Flag::NONE) {
-			Type movePiece = 0;
-			for (Bitmap posMap : positions[colour]) {
-				if (posMap & end) {
-					break;
-				}
-				movePiece++;
-			}
-			movePieceDefault(end, start, movePiece);
+			Type movePiece = mailbox[getEnd(move)];
+			movePieceDefault<us>(end, start, movePiece);
 			if (state.isCapture) {
 				Type taken = state.capture;
-				positions[!colour][taken] ^= end;
-
+				positions[them][taken] ^= end;
+				teamMaps[them] ^= end;
+				all ^= end;
+				mailbox[getEnd(move)] = taken;
 			}
 		}
 		else if (flag == Flag::EN_PASSANT) {
-			movePieceDefault(end, start, PAWN);
+			movePieceDefault<us>(end, start, PAWN);
 			Bitmap takenMap;
-			if (colour == WHITE) takenMap = epMap >> 8;
-			else                 takenMap = epMap << 8;
-			positions[!colour][PAWN] ^= takenMap;
+			if constexpr (us == WHITE) takenMap = epMap >> 8;
+			else                           takenMap = epMap << 8;
+			positions[them][PAWN] ^= takenMap;
+			teamMaps[them] ^= takenMap;
+			all ^= takenMap;
+			mailbox[getSinglePosition(takenMap)] = PAWN;
 
 		}
 		else if (flag == Flag::CASTLE) {
-			movePieceDefault(end, start, KING);
-			if (start > end) movePieceDefault(end << 1, end >> 1, ROOK);
-			else             movePieceDefault(end >> 1, end << 2, ROOK);
+			movePieceDefault<us>(end, start, KING);
+			if (start > end) movePieceDefault<us>(end << 1, end >> 1, ROOK);
+			else             movePieceDefault<us>(end >> 1, end << 2, ROOK);
 		}
 		else if (flag == Flag::PROMOTION) {
 			Type promoPiece = getPromotion(move);
-			positions[colour][promoPiece] ^= end;
-			positions[colour][PAWN] ^= start;
+			positions[us][promoPiece] ^= end;
+			positions[us][PAWN] ^= start;
+			teamMaps[us] ^= start | end;
+			all ^= start | end;
+			mailbox[getStart(move)] = PAWN;
+			mailbox[getEnd(move)] = NO_PIECE;
 			if (state.isCapture) {
 				Type taken = state.capture;
-				positions[!colour][taken] ^= end;
+				positions[them][taken] ^= end;
+				teamMaps[them] ^= end;
+				all ^= end;
+				mailbox[getEnd(move)] = taken;
 			}
 		}
-		updateTeamPositions();
 		zobrist = state.zobrist;
+		pawnKey = state.pawnKey;
+		materialKey = state.materialKey;
+		checkers = state.checkers;
+		pinned = state.pinned;
+		pliesFromNull = state.pliesFromNull;
+	}
+
+	void Position::loadCheckInfo() {
+		if (colour == WHITE) loadCheckInfo<WHITE>();
+		else                 loadCheckInfo<BLACK>();
 	}
 
-	void Board::loadZobrist() {
+	template <PieceColour us>
+	void Position::loadCheckInfo() {
+		constexpr PieceColour them = opposite(us);
+		Bitmap kingMap = positions[us][KING];
+		if (!kingMap) {
+			checkers = 0ULL;
+			pinned = 0ULL;
+			return;
+		}
+		int kingPos = getSinglePosition(kingMap);
+		Bitmap rookSliders = positions[them][ROOK] | positions[them][QUEEN];
+		Bitmap bishopSliders = positions[them][BISHOP] | positions[them][QUEEN];
+
+		checkers = (attacks::pawnAttacks(kingMap, us) & positions[them][PAWN])
+			| (attacks::knightAttacks(kingMap) & positions[them][KNIGHT])
+			| (rookPseudoLookup[kingPos][all] & rookSliders)
+			| (bishopPseudoLookup[kingPos][all] & bishopSliders);
+		pinned = attacks::blockers(kingPos, teamMaps[us], all, rookSliders, bishopSliders);
+	}
+
+	bool Position::isCheck() const {
+		return checkers;
+	}
+
+	Type Position::pieceOn(int position) const {
+		return mailbox[position];
+	}
+
+	template void Board::makeMove<WHITE>(Move move);
+	template void Board::makeMove<BLACK>(Move move);
+	template void Board::unmakeMove<WHITE>(Move move);
+	template void Board::unmakeMove<BLACK>(Move move);
+	template Position Position::afterMove<WHITE>(Move move) const;
+	template Position Position::afterMove<BLACK>(Move move) const;
+
+	void Position::loadZobrist() {
 		zobrist = 0;
+		pawnKey = 0;
+		materialKey = 0;
 		
 		// pieces
 		for (int team = 0; team <= 1; team = team+1) {
@@ -472,8 +911,13 @@ namespace chess
 				for (int pos = 0; pos < 64; pos++) {
 					if (bitset[pos] & positions[team][piece]) {
 						zobrist ^= zobristPieces[team][piece][pos];
+						if (piece == PAWN) pawnKey ^= zobristPieces[team][piece][pos];
 					}
 				}
+				// one key for each piece of the type, the first uses index 0
+				for (int count = 0; count < std::popcount(positions[team][piece]); count++) {
+					materialKey ^= zobristPieces[team][piece][count];
+				}
 			}
 		}
 		// team colour
@@ -488,6 +932,47 @@ namespace chess
 		
 	}
 
+	bool Board::isRepetition(int ply) const {
+		// only positions since the last capture, pawn move or null move can be repeated
+		int end = std::min({ (size_t)halfMoves, (size_t)pliesFromNull, pastStates.size() });
+		bool repeatedBeforeSearch = false;
+		// the same team has to be moving, and that takes at least 4 plies
+		for (int pliesAgo = 4; pliesAgo <= end; pliesAgo += 2) {
+			if (pastStates.fromTop(pliesAgo - 1).zobrist != zobrist) continue;
+			// a repeat inside the search could be repeated again, but history needs a third occurrence
+			if (pliesAgo < ply || repeatedBeforeSearch) return true;
+			repeatedBeforeSearch = true;
+		}
+		return false;
+	}
+
+	bool Board::isFiftyMoveDraw() const {
+		return halfMoves >= 100;
+	}
+
+	bool Board::hasUpcomingRepetition(int ply) const {
+		int end = std::min({ (size_t)halfMoves, (size_t)pliesFromNull, pastStates.size() });
+		for (int pliesAgo = 3; pliesAgo <= end; pliesAgo += 2) {
+			Zobrist moveKey = zobrist ^ pastStates.fromTop(pliesAgo - 1).zobrist;
+			size_t index = cuckooHash1(moveKey);
+			if (cuckooTable.keys[index] != moveKey) {
+				index = cuckooHash2(moveKey);
+				if (cuckooTable.keys[index] != moveKey) continue;
+			}
+
+			Move move = cuckooTable.moves[index];
+			int position1 = getStart(move), position2 = getEnd(move);
+			if (betweenLookup[position1][position2] & all) continue;
+			// the table holds both directions of the move, so check the piece on whichever end is filled
+			int piecePosition = (all & bitset[position1]) ? position1 : position2;
+			if (!(teamMaps[colour] & bitset[piecePosition])) continue;
+
+			// only cycles inside the search count, the positions before it only happened once
+			if (ply > pliesAgo) return true;
+		}
+		return false;
+	}
+
 	void chess::Board::print() const {
 		std::cout << toString() << std::endl;
 	}
@@ -0,0 +1,59 @@
+#include "cpu.hpp"
+
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <intrin.h>     // __cpuid
+#include <immintrin.h>  // _xgetbv
+#define HAS_CPUID
+#endif
+
+
+namespace chess
+{
+	namespace cpu
+	{
+		struct Features {
+			bool pext = false;
+			bool avx2 = false;
+		};
+
+		Features detectFeatures() {
+			Features features;
+#if defined(HAS_CPUID)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return features;
+			std::string vendor((char*)&info[1], 4);
+			vendor += std::string((char*)&info[3], 4) + std::string((char*)&info[2], 4);
+
+			__cpuid(info, 1);
+			int family = ((info[0] >> 8) & 0xf) + ((info[0] >> 20) & 0xff);
+			// the os also has to save the ymm registers (OSXSAVE, AVX and xcr0 bits 1 and 2)
+			bool hasOsxsave = info[2] & (1 << 27);
+			bool hasAvx = info[2] & (1 << 28);
+			bool savesYmm = hasOsxsave && hasAvx && (_xgetbv(0) & 0x6) == 0x6;
+
+			__cpuidex(info, 7, 0);
+			bool hasBmi2 = info[1] & (1 << 8);
+			features.avx2 = savesYmm && (info[1] & (1 << 5));
+			// pext is microcoded (and very slow) on AMD before zen 3 (family 0x19)
+			features.pext = hasBmi2 && !(vendor == "AuthenticAMD" && family < 0x19);
+#endif
+			return features;
+		}
+
+		const Features& features() {
+			static const Features detected = detectFeatures();
+			return detected;
+		}
+
+		bool hasPext() {
+			return features().pext;
+		}
+
+		bool hasAvx2() {
+			return features().avx2;
+		}
+	}
+}
@@ -3,12 +3,13 @@
 #include "pieces.hpp"
 
 #include <bit>
+#include <array>
 
 
 
 // piece square tables taken from https://www.chessprogramming.org/PeSTO%27s_Evaluation_Function
 // they are the tables for black's side
-int mgPawnTable[64] = {
+constexpr int mgPawnTable[64] = {
       0,   0,   0,   0,   0,   0,  0,   0,
      98, 134,  61,  95,  68, 126, 34, -11,
      -6,   7,  26,  31,  65,  56, 25, -20,
@@ -19,7 +20,7 @@ int mgPawnTable[64] = {
       0,   0,   0,   0,   0,   0,  0,   0,
 };
 
-int egPawnTable[64] = {
+constexpr int egPawnTable[64] = {
       0,   0,   0,   0,   0,   0,   0,   0,
     178, 173, 158, 134, 147, 132, 165, 187,
      94, 100,  85,  67,  56,  53,  82,  84,
@@ -30,7 +31,7 @@ int egPawnTable[64] = {
       0,   0,   0,   0,   0,   0,   0,   0,
 };
 
-int mgKnightTable[64] = {
+constexpr int mgKnightTable[64] = {
     -167, -89, -34, -49,  61, -97, -15, -107,
      -73, -41,  72,  36,  23,  62,   7,  -17,
      -47,  60,  37,  65,  84, 129,  73,   44,
@@ -41,7 +42,7 @@ int mgKnightTable[64] = {
     -105, -21, -58, -33, -17, -28, -19,  -23,
 };
 
-int egKnightTable[64] = {
+constexpr int egKnightTable[64] = {
     -58, -38, -13, -28, -31, -27, -63, -99,
     -25,  -8, -25,  -2,  -9, -25, -24, -52,
     -24, -20,  10,   9,  -1,  -9, -19, -41,
@@ -52,7 +53,7 @@ int egKnightTable[64] = {
     -29, -51, -23, -15, -22, -18, -50, -64,
 };
 
-int mgBishopTable[64] = {
+constexpr int mgBishopTable[64] = {
     -29,   4, -82, -37, -25, -42,   7,  -8,
     -26,  16, -18, -13,  30,  59,  18, -47,
     -16,  37,  43,  40,  35,  50,  37,  -2,
@@ -63,7 +64,7 @@ int mgBishopTable[64] = {
     -33,  -3, -14, -21, -13, -12, -39, -21,
 };
 
-int egBishopTable[64] = {
+constexpr int egBishopTable[64] = {
     -14, -21, -11,  -8, -7,  -9, -17, -24,
      -8,  -4,   7, -12, -3, -13,  -4, -14,
       2,  -8,   0,  -1, -2,   6,   0,   4,
@@ -74,7 +75,7 @@ int egBishopTable[64] = {
     -23,  -9, -23,  -5, -9, -16,  -5, -17,
 };
 
-int mgRookTable[64] = {
+constexpr int mgRookTable[64] = {
      32,  42,  32,  51, 63,  9,  31,  43,
      27,  32,  58,  62, 80, 67,  26,  44,
      -5,  19,  26,  36, 17, 45,  61,  16,
@@ -85,7 +86,7 @@ int mgRookTable[64] = {
     -19, -13,   1,  17, 16,  7, -37, -26,
 };
 
-int egRookTable[64] = {
+constexpr int egRookTable[64] = {
     13, 10, 18, 15, 12,  12,   8,   5,
     11, 13, 13, 11, -3,   3,   8,   3,
      7,  7,  7,  5,  4,  -3,  -5,  -3,
@@ -96,7 +97,7 @@ int egRookTable[64] = {
     -9,  2,  3, -1, -5, -13,   4, -20,
 };
 
-int mgQueenTable[64] = {
+constexpr int mgQueenTable[64] = {
     -28,   0,  29,  12,  59,  44,  43,  45,
     -24, -39,  -5,   1, -16,  57,  28,  54,
     -13, -17,   7,   8,  29,  56,  47,  57,
@@ -107,7 +108,7 @@ int mgQueenTable[64] = {
      -1, -18,  -9,  10, -15, -25, -31, -50,
 };
 
-int egQueenTable[64] = {
+constexpr int egQueenTable[64] = {
      -9,  22,  22,  27,  27,  19,  10,  20,
     -17,  20,  32,  41,  58,  25,  30,   0,
     -20,   6,   9,  49,  47,  35,  19,   9,
@@ -118,7 +119,7 @@ int egQueenTable[64] = {
     -33, -28, -22, -43,  -5, -32, -20, -41,
 };
 
-int mgKingTable[64] = {
+constexpr int mgKingTable[64] = {
     -65,  23,  16, -15, -56, -34,   2,  13,
      29,  -1, -20,  -7,  -8,  -4, -38, -29,
      -9,  24,   2, -16, -20,   6,  22, -22,
@@ -129,7 +130,7 @@ int mgKingTable[64] = {
     -15,  36,  12, -54,   8, -28,  24,  14,
 };
 
-int egKingTable[64] = {
+constexpr int egKingTable[64] = {
     -74, -35, -18, -18, -11,  15,   4, -17,
     -12,  17,  14,  17,  17,  38,  23,  11,
      10,  17,  23,  15,  20,  45,  44,  13,
@@ -140,7 +141,7 @@ int egKingTable[64] = {
     -53, -34, -21, -11, -28, -14, -24, -43
 };
 
-int* blackMg[6] = {
+constexpr const int* blackMg[6] = {
     mgPawnTable,
     mgKnightTable,
     mgBishopTable,
@@ -148,7 +149,7 @@ int* blackMg[6] = {
     mgQueenTable,
     mgKingTable
 };
-int* blackEg[6] = {
+constexpr const int* blackEg[6] = {
     egPawnTable,
     egKnightTable,
     egBishopTable,
@@ -164,28 +165,27 @@ const int maxGamePhase = 24;
 namespace chess
 {
     // returns the index the vertically mirrored position
-    int flipPos(int pos) {
+    constexpr int flipPos(int pos) {
         return pos ^ 56;
     }
 
-    int mgTable[2][6][64];
+    using PieceSquareTable = std::array<std::array<std::array<int, 64>, 6>, 2>;
 
-    int egTable[2][6][64];
-
-    struct TableLoader {
-        TableLoader() {
-            for (Type type = PAWN; type <= KING; type++) {
-                for (int pos = 0; pos < 64; pos++) {
-                    mgTable[BLACK][type][pos] = blackMg[type][pos];
-                    egTable[BLACK][type][pos] = blackEg[type][pos];
-                    mgTable[WHITE][type][pos] = blackMg[type][flipPos(pos)];
-                    egTable[WHITE][type][pos] = blackEg[type][flipPos(pos)];
-                }
+    // builds both teams' tables from black's, at compile time
+    constexpr PieceSquareTable loadTable(const int* const black[6]) {
+        PieceSquareTable table{};
+        for (Type type = PAWN; type <= KING; type++) {
+            for (int pos = 0; pos < 64; pos++) {
+                table[BLACK][type][pos] = black[type][pos];
+                table[WHITE][type][pos] = black[type][flipPos(pos)];
             }
         }
-    };
-    
-    TableLoader tableLoader;
+        return table;
+    }
+
+    constexpr PieceSquareTable mgTable = loadTable(blackMg);
+
+    constexpr PieceSquareTable egTable = loadTable(blackEg);
 
     int getScoreSum(const Board& board) {
         int scoreSum = 0;
@@ -141,15 +141,10 @@ namespace chess
 		// no friendly piece on that square
 		if ((posmap & board.teamMaps[board.colour]) == 0) return;
 
-		for (Type type = PAWN; type <= KING; type++) {
-			if (board.positions[board.colour][type] & posmap) {
-				holding = Piece(type, board.colour);
-				pickedPosition = pos;
-				isHolding = true;
-				updateMoveHighlights();
-				return;
-			}
-		}
+		holding = Piece(board.pieceOn(pos), board.colour);
+		pickedPosition = pos;
+		isHolding = true;
+		updateMoveHighlights();
 	}
 
 	void chess::Game::placeHolding(int pos) {
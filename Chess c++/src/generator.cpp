@@ -1,6 +1,7 @@
 #include "generator.hpp"
 
 #include "magics.hpp"
+#include "attacks.hpp"
 #include "bitboard.hpp"
 #include "move.hpp"
 #include "pieces.hpp"
@@ -8,47 +9,101 @@
 #include <iostream>
 #include <cassert>
 #include <bit>
+#include <array>
+#include <algorithm>
 
 namespace chess
 {
-	const Bitmap pawnEndRows[2] = { 0xffULL << 48, 0xffULL << 8 };
-	const Bitmap pawnDoubleStepRows[2] = { 0xffULL << 16, 0xffULL << 40 };
-	const int pawnStepSizes[2] = { 8, -8 };
+	constexpr Bitmap pawnEndRows[2] = { 0xffULL << 48, 0xffULL << 8 };
+	constexpr Bitmap pawnDoubleStepRows[2] = { 0xffULL << 16, 0xffULL << 40 };
+	constexpr int pawnStepSizes[2] = { 8, -8 };
 	const Bitmap AFile = 0x8080808080808080;
 
-	// defined at bottom
-	void loadPawnPseudoPushMoves(Bitmap arr[2][64]);
-
-	void loadPawnPseudoAttackMoves(Bitmap arr[2][64]);
-
-	void loadKnightPseudoMoves(Bitmap arr[64]);
-
-	void loadBishopPseudoMoves(MagicLookup arr[64]);
+	constexpr std::array<std::array<Bitmap, 64>, 2> loadPawnPseudoPushMoves() {
+		std::array<std::array<Bitmap, 64>, 2> arr{};
+		for (int pos = 0; pos < 64; pos++) {
+			Bitmap posMap = bitset[pos];
+			arr[WHITE][pos] = posMap << 8;
+			arr[BLACK][pos] = posMap >> 8;
+		}
+		return arr;
+	}
 
-	void loadRookPseudoMoves(MagicLookup arr[64]);
+	constexpr std::array<std::array<Bitmap, 64>, 2> loadPawnPseudoAttackMoves() {
+		std::array<std::array<Bitmap, 64>, 2> arr{};
+		for (int pos = 0; pos < 64; pos++) {
+			int col = 7 - pos % 8; // a=0 ... h=7
+			Bitmap posMap = bitset[pos];
+			Bitmap whiteMask = 0, blackMask = 0;
+			if (col != 7) { // not far right
+				whiteMask |= posMap << 7;
+				blackMask |= posMap >> 9;
+			}
+			if (col != 0) { // not far right
+				whiteMask |= posMap << 9;
+				blackMask |= posMap >> 7;
+			}
+			arr[WHITE][pos] = whiteMask;
+			arr[BLACK][pos] = blackMask;
+		}
+		return arr;
+	}
 
-	void loadKingPseudoMoves(Bitmap arr[64]);
+	constexpr std::array<Bitmap, 64> loadKnightPseudoMoves() {
+		std::array<Bitmap, 64> arr{};
+		for (int pos = 0; pos < 64; pos++) {
+			Bitmap neighbours = 0ULL;
+			int row = 7 - pos / 8, col =7 - pos % 8;
+			if (row < 7) { // not on bottom row
+				if (col < 6) neighbours |= bitset[pos - 10];
+				if (col > 1) neighbours |= bitset[pos - 6];
+			}
+			if (row < 6) { // not second bottom row
+				if (col < 7) neighbours |= bitset[pos - 17];
+				if (col > 0) neighbours |= bitset[pos - 15];
+			}
+			if (row > 0) { // not top row
+				if (col < 6) neighbours |= bitset[pos + 6];
+				if (col > 1) neighbours |= bitset[pos + 10];
+			}
+			if (row > 1) { // not second top row
+				if (col < 7) neighbours |= bitset[pos + 15];
+				if (col > 0) neighbours |= bitset[pos + 17];
+			}
+			arr[pos] = neighbours;
+		}
+		return arr;
+	}
 
-	Bitmap pawnPushLookup[2][64];
-	Bitmap pawnAttackLookup[2][64];
-	Bitmap knightPseudoLookup[64];
-	MagicLookup bishopPseudoLookup[64];
-	MagicLookup rookPseudoLookup[64];
-	Bitmap kingPseudoLookup[64];
-	
+	constexpr std::array<Bitmap, 64> loadKingPseudoMoves() {
+		std::array<Bitmap, 64> arr{};
+		for (int pos = 0; pos < 64; pos++) {
+			int row = pos / 8, col = 7 - pos % 8;
+			Bitmap neighbours = 0ULL;
+			if (row > 0) {
+				neighbours |= bitset[pos - 8];
+				if (col > 0)  neighbours |= bitset[pos - 7];
+				if (col < 7)  neighbours |= bitset[pos - 9];
+			}
+			if (row < 7) {
+				neighbours |= bitset[pos + 8];
+				if (col > 0)  neighbours |= bitset[pos + 9];
+				if (col < 7)  neighbours |= bitset[pos + 7];
+			}
+			if (col > 0) neighbours |= bitset[pos + 1];
+			if (col < 7) neighbours |= bitset[pos - 1];
 
-	struct Startup {
-		Startup() {
-			loadPawnPseudoPushMoves(pawnPushLookup);
-			loadPawnPseudoAttackMoves(pawnAttackLookup);
-			loadKnightPseudoMoves(knightPseudoLookup);
-			loadBishopPseudoMoves(bishopPseudoLookup);
-			loadRookPseudoMoves(rookPseudoLookup);
-			loadKingPseudoMoves(kingPseudoLookup);
+			arr[pos] = neighbours;
 		}
-	};
+		return arr;
+	}
 
-	Startup startup;
+	// generated at compile time
+	// the bishop and rook lookups are in magics.cpp
+	constexpr std::array<std::array<Bitmap, 64>, 2> pawnPushLookup = loadPawnPseudoPushMoves();
+	constexpr std::array<std::array<Bitmap, 64>, 2> pawnAttackLookup = loadPawnPseudoAttackMoves();
+	constexpr std::array<Bitmap, 64> knightPseudoLookup = loadKnightPseudoMoves();
+	constexpr std::array<Bitmap, 64> kingPseudoLookup = loadKingPseudoMoves();
 
 	Generator::Generator() {
 		board = nullptr;
@@ -56,195 +111,190 @@ namespace chess
 		enemyEmptyMask = 0ULL;
 		checkMask = 0ULL;
 		attackMask = 0ULL;
-		std::fill(pinMasks, pinMasks + 64, 0ULL);
+		kingPosition = 0;
 	}
-	Generator::Generator(Board& pboard) {
+	Generator::Generator(Position& pboard) {
 		board = &pboard;
 		moves = nullptr;
 		enemyEmptyMask = 0ULL;
 		checkMask = 0ULL;
 		attackMask = 0ULL;
-		std::fill(pinMasks, pinMasks + 64, 0ULL);
+		kingPosition = 0;
 	}
 
 	bool Generator::isCheck() {
 		return !(checkMask == ~0);
 	}
 
-	void Generator::getLegalMoves(MoveList* moveList, bool captures) {
-		assert(board);
-		moves = moveList;
-		
-		if (!board->positions[board->colour][KING]) return;
-
-		loadEnemyEmptyMask();
-		loadCheckMask();
-		loadAttackMask();
-		loadPinMasks();
-
-		if (captures) {
-			enemyEmptyMask = board->teamMaps[!board->colour];
-		}
+	void Generator::getLegalMoves(MoveList* moveList, MoveType type) {
+		if (board->colour == WHITE) getLegalMoves<WHITE>(moveList, type);
+		else                        getLegalMoves<BLACK>(moveList, type);
+	}
 
-		addPawnMoves();
-		addKnightMoves();
-		addBishopMoves();
-		addRookMoves();
-		addQueenMoves();
-		addKingMoves();
-		addCastleMoves();
-		addPromotionMoves();
-		addEnPassantMoves();
+	template <PieceColour us>
+	void Generator::getLegalMoves(MoveList* moveList, MoveType type) {
+		loadMasks<us>();
+		getLoadedMoves<us>(moveList, type);
 	}
 
-	void Generator::loadEnemyEmptyMask() {
-		enemyEmptyMask = ~board->teamMaps[board->colour];
+	void Generator::loadMasks() {
+		if (board->colour == WHITE) loadMasks<WHITE>();
+		else                        loadMasks<BLACK>();
 	}
 
-	void Generator::loadCheckMask() {
-		checkMask = ~0ULL;
+	template <PieceColour us>
+	void Generator::loadMasks() {
+		assert(board);
+		assert(board->colour == us);
 
-		bool alreadyChecked = false;
+		if (!board->positions[us][KING]) return;
 
-		int kingPos = getSinglePosition(board->positions[board->colour][KING]);
+		loadEnemyEmptyMask<us>();
+		loadCheckMask<us>();
+		loadAttackMask<us>();
+	}
 
-		Bitmap* enemies = board->positions[1 - board->colour];
+	void Generator::getLoadedMoves(MoveList* moveList, MoveType type) {
+		if (board->colour == WHITE) getLoadedMoves<WHITE>(moveList, type);
+		else                        getLoadedMoves<BLACK>(moveList, type);
+	}
 
-		// knights
-		Bitmap knightMap = pseudoKnight(kingPos) & enemies[KNIGHT];
-		int numKnights = std::popcount(knightMap);
-		if (numKnights >= 2) {
-			checkMask = 0;
-			return;
-		}
-		else if (numKnights == 1) {
-			checkMask &= knightMap;
-			alreadyChecked = true;
-		}
+	template <PieceColour us>
+	void Generator::getLoadedMoves(MoveList* moveList, MoveType type) {
+		constexpr PieceColour them = opposite(us);
+		moves = moveList;
 		
-		// pawns
-		Bitmap pawnMap = pawnAttackLookup[board->colour][kingPos] & enemies[PAWN];
-		int numPawns = std::popcount(pawnMap);
-		if ((numPawns + alreadyChecked) >= 2) {
-			checkMask = 0;
-			return;
-		}
-		else if (numPawns == 1) {
-			checkMask &= pawnMap;
-			alreadyChecked = true;
+		if (!board->positions[us][KING]) return;
+
+		switch (type) {
+		case MoveType::ALL:      loadEnemyEmptyMask<us>(); break;
+		case MoveType::CAPTURES: enemyEmptyMask = board->teamMaps[them]; break;
+		case MoveType::QUIETS:
+		case MoveType::QUIET_CHECKS: enemyEmptyMask = ~board->all; break;
 		}
-		
-		// rooks
-		Bitmap rookMap = pseudoRook(kingPos) & (enemies[ROOK] | enemies[QUEEN]);
-		int numRooks = std::popcount(rookMap);
-		if ((numRooks + alreadyChecked) >= 2) {
-			checkMask = 0;
+
+		if (isCheck()) {
+			if (type != MoveType::QUIET_CHECKS) addEvasions<us>(type);
 			return;
 		}
-		else if (numRooks == 1) {
-			int rookPos = getSinglePosition(rookMap);
-			checkMask &= (pseudoRook(kingPos) & pseudoRook(rookPos)) | rookMap;
-		}
-		// bishops
-		Bitmap bishopMap = pseudoBishop(kingPos) & (enemies[BISHOP] | enemies[QUEEN]);
-		int numBishops = std::popcount(bishopMap);
-		if ((numBishops + alreadyChecked) >= 2) {
-			checkMask = 0;
+
+		if (type == MoveType::QUIET_CHECKS) {
+			loadCheckSquares<us>();
+			addQuietChecks<us>();
 			return;
 		}
-		else if (numBishops == 1) {
-			int bishopPos = getSinglePosition(bishopMap);
-			checkMask &= (pseudoBishop(kingPos) & pseudoBishop(bishopPos)) | bishopMap;
-		}
+
+		addPawnMoves<us>();
+		addKnightMoves<us>();
+		addBishopMoves<us>();
+		addRookMoves<us>();
+		addQueenMoves<us>();
+		addKingMoves<us>();
+		if (type != MoveType::CAPTURES) addCastleMoves<us>();
+		addPromotionMoves<us>();
+		if (type != MoveType::QUIETS) addEnPassantMoves<us>();
 	}
 
-	void Generator::loadAttackMask() {
-		Bitmap teamKingMap = board->positions[board->colour][KING];
-		// ignore the king
-		board->positions[board->colour][KING] = 0ULL;
-		board->all ^= teamKingMap;
+	bool Generator::isLegal(Move move) {
+		if (board->colour == WHITE) return isLegal<WHITE>(move);
+		else                        return isLegal<BLACK>(move);
+	}
 
-		Bitmap result = 0ULL;
+	template <PieceColour us>
+	bool Generator::isLegal(Move move) {
+		if (move == NULL_MOVE || !board->positions[us][KING]) return false;
 
-		Bitmap pawnMap = board->positions[1 - board->colour][PAWN];
-		while (pawnMap) {
-			int position = getNextPosition(pawnMap);
-			result |= pawnAttackLookup[1-board->colour][position];
-		}
+		int start = getStart(move);
+		Bitmap startMap = bitset[start];
+		Bitmap endMap = bitset[getEnd(move)];
+		if (!(startMap & board->teamMaps[us])) return false;
 
-		Bitmap knightMap = board->positions[1 - board->colour][KNIGHT];
-		while (knightMap) {
-			int position = getNextPosition(knightMap);
-			result |= pseudoKnight(position);
+		Flag flag = getFlag(move);
+		if (flag == Flag::CASTLE || flag == Flag::EN_PASSANT) {
+			// rare enough to just generate them and look
+			// Generator::moves is pointed at a local list only while adding, then put back
+			MoveList specialMoves;
+			MoveList* savedMoves = moves;
+			moves = &specialMoves;
+			if (flag == Flag::CASTLE) addCastleMoves<us>();
+			else                      addEnPassantMoves<us>();
+			moves = savedMoves;
+			return std::find(specialMoves.begin(), specialMoves.end(), move) != specialMoves.end();
 		}
 
-		Bitmap bishopMap = board->positions[1 - board->colour][BISHOP];
-		while (bishopMap) {
-			int position = getNextPosition(bishopMap);
-			result |= pseudoBishop(position);
-		}
+		Type piece = board->pieceOn(start);
 
-		Bitmap rookMap = board->positions[1 - board->colour][ROOK];
-		while (rookMap) {
-			int position = getNextPosition(rookMap);
-			result |= pseudoRook(position);
-		}
+		// only pawns on the end row promote, and they always have to
+		bool promotes = piece == PAWN && (startMap & pawnEndRows[us]);
+		if (promotes != (flag == Flag::PROMOTION)) return false;
 
-		Bitmap queenMap = board->positions[1 - board->colour][QUEEN];
-		while (queenMap) {
-			int position = getNextPosition(queenMap);
-			result |= pseudoQueen(position);
+		Bitmap legalMoves;
+		switch (piece) {
+		case PAWN:   legalMoves = pseudoPawn<us>(start); break;
+		case KNIGHT: legalMoves = pseudoKnight(start); break;
+		case BISHOP: legalMoves = pseudoBishop(start); break;
+		case ROOK:   legalMoves = pseudoRook(start); break;
+		case QUEEN:  legalMoves = pseudoQueen(start); break;
+		default:     return (bool)(pseudoKing(start) & ~attackMask & ~board->teamMaps[us] & endMap);
 		}
+		return (bool)(legalMoves & checkMask & pinMask(start) & ~board->teamMaps[us] & endMap);
+	}
 
-		Bitmap kingMap = board->positions[1 - board->colour][KING];
-		
-		int position = getSinglePosition(kingMap);
-		result |= pseudoKing(position);
+	bool Generator::isAttacked(int position) {
+		return attackMask & bitset[position];
+	}
+
+	template <PieceColour us>
+	void Generator::loadEnemyEmptyMask() {
+		enemyEmptyMask = ~board->teamMaps[us];
+	}
 
-		board->all |= teamKingMap;
-		board->positions[board->colour][KING] = teamKingMap;
+	template <PieceColour us>
+	void Generator::loadCheckMask() {
+		kingPosition = getSinglePosition(board->positions[us][KING]);
+		Bitmap checkers = board->checkers;
 
-		attackMask = result;
+		if (!checkers) checkMask = ~0ULL;
+		// double check, only the king can move
+		else if (checkers & (checkers - 1)) checkMask = 0ULL;
+		// take the checking piece or block it
+		else checkMask = checkers | betweenLookup[kingPosition][getSinglePosition(checkers)];
 	}
 
-	void Generator::loadPinMasks() {
-		for (int position = 0; position < 64; position++) {
-			pinMasks[position] = ~0ULL;
-		}
-		
-		int kingPos = getSinglePosition(board->positions[board->colour][KING]);
-
-		Bitmap rookMap = board->positions[1 - board->colour][ROOK];
-		Bitmap bishopMap = board->positions[1 - board->colour][BISHOP];
-		Bitmap queenMap = board->positions[1 - board->colour][QUEEN];
-
-		Bitmap rookPseudo = rookPseudoLookup[kingPos][board->all];
-		Bitmap teamRookPseudo = rookPseudo & board->teamMaps[board->colour];
-		while (teamRookPseudo) {
-			Bitmap posMap = teamRookPseudo & (~teamRookPseudo + 1);
-			teamRookPseudo &= teamRookPseudo - 1;
-
-			Bitmap newRookPseudo = rookPseudoLookup[kingPos][board->all ^ posMap];
-			if (newRookPseudo & (rookMap | queenMap) & ~rookPseudo) {
-				int pos = getSinglePosition(posMap);
-				Bitmap newPositionPseudo = rookPseudoLookup[pos][board->all];
-				pinMasks[pos] &= newPositionPseudo & newRookPseudo;
-			}
-		}
+	template <PieceColour us>
+	void Generator::loadAttackMask() {
+		constexpr PieceColour them = opposite(us);
+		// sliders see through the king, so it can't step back along their line
+		Bitmap empty = ~(board->all ^ board->positions[us][KING]);
+		Bitmap queenMap = board->positions[them][QUEEN];
 
-		Bitmap bishopPseudo = bishopPseudoLookup[kingPos][board->all];
-		Bitmap teamBishopPseudo = bishopPseudo & board->teamMaps[board->colour];
-		while (teamBishopPseudo) {
-			Bitmap posMap = teamBishopPseudo & (~teamBishopPseudo + 1);
-			teamBishopPseudo &= teamBishopPseudo - 1;
-
-			Bitmap newBishopPseudo = bishopPseudoLookup[kingPos][board->all ^ posMap];
-			if (newBishopPseudo & (bishopMap | queenMap) & ~bishopPseudo) {
-				int pos = getSinglePosition(posMap);
-				Bitmap newPositionPseudo = bishopPseudoLookup[pos][board->all];
-				pinMasks[pos] &= newPositionPseudo & newBishopPseudo;
-			}
-		}
+		attackMask = attacks::pawnAttacks(board->positions[them][PAWN], them)
+			| attacks::knightAttacks(board->positions[them][KNIGHT])
+			| attacks::kingAttacks(board->positions[them][KING])
+			| attacks::sliderAttacks(board->positions[them][ROOK] | queenMap, board->positions[them][BISHOP] | queenMap, empty);
+	}
+
+	template <PieceColour us>
+	void Generator::loadCheckSquares() {
+		constexpr PieceColour them = opposite(us);
+		int kingPos = getSinglePosition(board->positions[them][KING]);
+
+		checkSquares[PAWN] = pawnAttackLookup[them][kingPos];
+		checkSquares[KNIGHT] = knightPseudoLookup[kingPos];
+		checkSquares[BISHOP] = bishopPseudoLookup[kingPos][board->all];
+		checkSquares[ROOK] = rookPseudoLookup[kingPos][board->all];
+		checkSquares[QUEEN] = checkSquares[BISHOP] | checkSquares[ROOK];
+		checkSquares[KING] = 0ULL;
+
+		Bitmap queenMap = board->positions[us][QUEEN];
+		discoverers = attacks::blockers(kingPos, board->teamMaps[us], board->all,
+			board->positions[us][ROOK] | queenMap, board->positions[us][BISHOP] | queenMap);
+	}
+
+	Bitmap Generator::pinMask(int position) {
+		// a pinned piece can only move along the line between the king and the pinning piece
+		if (board->pinned & bitset[position]) return lineLookup[kingPosition][position];
+		return ~0ULL;
 	}
 
 	void Generator::addMoves(int position, Bitmap map, Flag flag, Type promotionPiece) {
@@ -257,86 +307,87 @@ namespace chess
 		}
 	}
 
+	template <PieceColour us>
 	void Generator::addPawnMoves() {
-		Bitmap posMap = board->positions[board->colour][PAWN];
-		Bitmap endRow = pawnEndRows[board->colour];
+		Bitmap posMap = board->positions[us][PAWN];
+		Bitmap endRow = pawnEndRows[us];
 		posMap &= ~endRow;  // pawns on the end row  are dealt with in addPromotionMoves()
 		while (posMap) {
 			int position = getNextPosition(posMap);
-			Bitmap pseudoMoves = pseudoPawn(position);
-			Bitmap pinMask = pinMasks[position];
-			Bitmap legalMoves = pseudoMoves & checkMask & pinMask & enemyEmptyMask;
+			Bitmap pseudoMoves = pseudoPawn<us>(position);
+			Bitmap legalMoves = pseudoMoves & checkMask & pinMask(position) & enemyEmptyMask;
 			
 			addMoves(position, legalMoves, Flag::NONE, PAWN);
 		}
 	}
 
+	template <PieceColour us>
 	void Generator::addKnightMoves() {
-		Bitmap posMap = board->positions[board->colour][KNIGHT];
+		Bitmap posMap = board->positions[us][KNIGHT];
 		while (posMap) {
 			int position = getNextPosition(posMap);
 			Bitmap pseudoMoves = knightPseudoLookup[position];
-			Bitmap pinMask = pinMasks[position];
-			Bitmap legalMoves = pseudoMoves & checkMask & pinMask & enemyEmptyMask;
+			Bitmap legalMoves = pseudoMoves & checkMask & pinMask(position) & enemyEmptyMask;
 			addMoves(position, legalMoves, Flag::NONE, PAWN);
 		}
 	}
 
+	template <PieceColour us>
 	void Generator::addBishopMoves() {
-		Bitmap posMap = board->positions[board->colour][BISHOP];
+		Bitmap posMap = board->positions[us][BISHOP];
 		while (posMap) {
 			int position = getNextPosition(posMap);
 			Bitmap pseudoMoves = pseudoBishop(position);
-			Bitmap pinMask = pinMasks[position];
-			Bitmap legalMoves = pseudoMoves & checkMask & pinMask & enemyEmptyMask;
+			Bitmap legalMoves = pseudoMoves & checkMask & pinMask(position) & enemyEmptyMask;
 			addMoves(position, legalMoves, Flag::NONE, PAWN);
 		}
 	}
 
+	template <PieceColour us>
 	void Generator::addRookMoves() {
-		Bitmap posMap = board->positions[board->colour][ROOK];
+		Bitmap posMap = board->positions[us][ROOK];
 		while (posMap) {
 			int position = getNextPosition(posMap);
 			Bitmap pseudoMoves = pseudoRook(position);
-			Bitmap pinMask = pinMasks[position];
-			Bitmap legalMoves = pseudoMoves & checkMask & pinMask & enemyEmptyMask;
+			Bitmap legalMoves = pseudoMoves & checkMask & pinMask(position) & enemyEmptyMask;
 			addMoves(position, legalMoves, Flag::NONE, PAWN);
 			
 		}
 	}
 
+	template <PieceColour us>
 	void Generator::addQueenMoves() {
-		Bitmap posMap = board->positions[board->colour][QUEEN];
+		Bitmap posMap = board->positions[us][QUEEN];
 		while (posMap) {
 			int position = getNextPosition(posMap);
 			Bitmap pseudoMoves = pseudoQueen(position);
-			Bitmap pinMask = pinMasks[position];
-			Bitmap legalMoves = pseudoMoves & checkMask & pinMask & enemyEmptyMask;
+			Bitmap legalMoves = pseudoMoves & checkMask & pinMask(position) & enemyEmptyMask;
 			addMoves(position, legalMoves, Flag::NONE, PAWN);
 		}
 	}
 	
+	template <PieceColour us>
 	void Generator::addKingMoves() {
-		int position = getSinglePosition(board->positions[board->colour][KING]);
+		int position = getSinglePosition(board->positions[us][KING]);
 		Bitmap pseudoMoves = pseudoKing(position);
-		Bitmap pinMask = pinMasks[position];
 		Bitmap legalMoves = pseudoMoves & ~attackMask & enemyEmptyMask;
 		addMoves(position, legalMoves, Flag::NONE, PAWN);
 	}
 
+	template <PieceColour us>
 	void Generator::addCastleMoves() {
 		
-		Bitmap kingMap = board->positions[board->colour][KING];
+		Bitmap kingMap = board->positions[us][KING];
 
 		Bitmap otherPositions = board->all & ~kingMap;
 
-		if (board->rightCastles[board->colour]) {
+		if (board->rightCastles[us]) {
 			Bitmap coveredPositions = kingMap | (kingMap >> 1) | (kingMap >> 2);
 			if (!(coveredPositions & attackMask) && !(coveredPositions & otherPositions)) {
 				addMoves(getSinglePosition(kingMap), kingMap >> 2, Flag::CASTLE, PAWN);
 			}
 		}
-		if (board->leftCastles[board->colour]) {
+		if (board->leftCastles[us]) {
 			Bitmap coveredPositions = kingMap | (kingMap << 1) | (kingMap << 2) | (kingMap << 3);
 			Bitmap noAttackPositions = kingMap | (kingMap << 1) | (kingMap << 2);
 			if (!(noAttackPositions & attackMask) && !(coveredPositions & otherPositions)) {
@@ -345,37 +396,39 @@ namespace chess
 		}
 	}
 
+	template <PieceColour us>
 	void Generator::addPromotionMoves() {
 		constexpr Type promotionPieces[4] = { KNIGHT, BISHOP, ROOK, QUEEN };
 
-		Bitmap endRow = pawnEndRows[board->colour];
-		Bitmap startMap = board->positions[board->colour][PAWN] & endRow;
+		Bitmap endRow = pawnEndRows[us];
+		Bitmap startMap = board->positions[us][PAWN] & endRow;
 
 		while (startMap) {
 			int pos = getNextPosition(startMap);
-			Bitmap pseudoMoves = pseudoPawn(pos);
-			Bitmap pinMask = pinMasks[pos];
-			Bitmap legalMoves = pseudoMoves & checkMask & pinMask & enemyEmptyMask;
+			Bitmap pseudoMoves = pseudoPawn<us>(pos);
+			Bitmap legalMoves = pseudoMoves & checkMask & pinMask(pos) & enemyEmptyMask;
 			for (Type type : promotionPieces) {
 				addMoves(pos, legalMoves, Flag::PROMOTION, type);
 			}
 		}
 	}
 
+	template <PieceColour us>
 	void Generator::addEnPassantMoves() {
+		constexpr PieceColour them = opposite(us);
 		if (!board->epMap) return;
 		int epPos = getSinglePosition(board->epMap);
-		Bitmap pawnMap = pawnPushLookup[1 - board->colour][epPos];
+		Bitmap pawnMap = pawnPushLookup[them][epPos];
 
 		if (!(pawnMap & checkMask)) return;
 
-		Bitmap startMap = pawnAttackLookup[1 - board->colour][epPos];
-		startMap &= board->positions[board->colour][PAWN];
+		Bitmap startMap = pawnAttackLookup[them][epPos];
+		startMap &= board->positions[us][PAWN];
 
-		int kingPos = getSinglePosition(board->positions[board->colour][KING]);
-		Bitmap rookMap = board->positions[1 - board->colour][ROOK];
-		Bitmap bishopMap = board->positions[1 - board->colour][BISHOP];
-		Bitmap queenMap = board->positions[1 - board->colour][QUEEN];
+		int kingPos = getSinglePosition(board->positions[us][KING]);
+		Bitmap rookMap = board->positions[them][ROOK];
+		Bitmap bishopMap = board->positions[them][BISHOP];
+		Bitmap queenMap = board->positions[them][QUEEN];
 
 		while (startMap) {
 			int pos = getNextPosition(startMap);
@@ -387,16 +440,101 @@ namespace chess
 
 	}
 
+	template <PieceColour us>
+	void Generator::addQuietChecks() {
+		constexpr Type pieceTypes[5] = { PAWN, KNIGHT, BISHOP, ROOK, QUEEN };
+		constexpr PieceColour them = opposite(us);
+		int enemyKingPos = getSinglePosition(board->positions[them][KING]);
+
+		for (Type type : pieceTypes) {
+			Bitmap posMap = board->positions[us][type];
+			// pawns on the end row are dealt with in addPromotionMoves()
+			if (type == PAWN) posMap &= ~pawnEndRows[us];
+			while (posMap) {
+				int position = getNextPosition(posMap);
+				Bitmap targets = checkSquares[type];
+				// moving anywhere off the line to the enemy king uncovers a check
+				if (bitset[position] & discoverers) targets |= ~lineLookup[position][enemyKingPos];
+
+				Bitmap pseudoMoves;
+				switch (type) {
+				case PAWN:   pseudoMoves = pseudoPawn<us>(position); break;
+				case KNIGHT: pseudoMoves = pseudoKnight(position); break;
+				case BISHOP: pseudoMoves = pseudoBishop(position); break;
+				case ROOK:   pseudoMoves = pseudoRook(position); break;
+				default:     pseudoMoves = pseudoQueen(position); break;
+				}
+				addMoves(position, pseudoMoves & pinMask(position) & enemyEmptyMask & targets, Flag::NONE, PAWN);
+			}
+		}
+
+		// the king can only give a discovered check
+		int kingPos = getSinglePosition(board->positions[us][KING]);
+		if (bitset[kingPos] & discoverers) {
+			Bitmap legalMoves = pseudoKing(kingPos) & ~attackMask & enemyEmptyMask & ~lineLookup[kingPos][enemyKingPos];
+			addMoves(kingPos, legalMoves, Flag::NONE, PAWN);
+		}
+
+		addPromotionMoves<us>();
+	}
+
+	template <PieceColour us>
+	void Generator::addEvasions(MoveType type) {
+		constexpr Type promotionPieces[4] = { KNIGHT, BISHOP, ROOK, QUEEN };
+
+		addKingMoves<us>();
+		// double check, only the king can move
+		if (!checkMask) return;
+
+		// every other move has to block or take the single checking piece
+		Bitmap targets = checkMask & enemyEmptyMask;
+		// a pinned piece can never do that
+		Bitmap movable = ~board->pinned;
+
+		Bitmap pawnMap = board->positions[us][PAWN] & movable;
+		while (pawnMap) {
+			int position = getNextPosition(pawnMap);
+			Bitmap legalMoves = pseudoPawn<us>(position) & targets;
+			if (bitset[position] & pawnEndRows[us]) {
+				for (Type promotionType : promotionPieces) addMoves(position, legalMoves, Flag::PROMOTION, promotionType);
+			}
+			else addMoves(position, legalMoves, Flag::NONE, PAWN);
+		}
+
+		Bitmap knightMap = board->positions[us][KNIGHT] & movable;
+		while (knightMap) {
+			int position = getNextPosition(knightMap);
+			addMoves(position, pseudoKnight(position) & targets, Flag::NONE, PAWN);
+		}
+
+		Bitmap bishopMap = (board->positions[us][BISHOP] | board->positions[us][QUEEN]) & movable;
+		while (bishopMap) {
+			int position = getNextPosition(bishopMap);
+			Bitmap legalMoves = pseudoBishop(position);
+			if (bitset[position] & board->positions[us][QUEEN]) legalMoves |= pseudoRook(position);
+			addMoves(position, legalMoves & targets, Flag::NONE, PAWN);
+		}
+
+		Bitmap rookMap = board->positions[us][ROOK] & movable;
+		while (rookMap) {
+			int position = getNextPosition(rookMap);
+			addMoves(position, pseudoRook(position) & targets, Flag::NONE, PAWN);
+		}
+
+		if (type != MoveType::QUIETS) addEnPassantMoves<us>();
+	}
+
+	template <PieceColour us>
 	Bitmap Generator::pseudoPawn(int pos) {
 		Bitmap nall = ~board->all;
-		Bitmap forwardMap = pawnPushLookup[board->colour][pos];
+		Bitmap forwardMap = pawnPushLookup[us][pos];
 		forwardMap &= nall;  // can't step on another piece
 
-		if (forwardMap & pawnDoubleStepRows[board->colour]) {
-			forwardMap |= pawnPushLookup[board->colour][pos + pawnStepSizes[board->colour]] & nall;
+		if (forwardMap & pawnDoubleStepRows[us]) {
+			forwardMap |= pawnPushLookup[us][pos + pawnStepSizes[us]] & nall;
 		}
 		
-		Bitmap attackMap = pawnAttackLookup[board->colour][pos] & board->all;
+		Bitmap attackMap = pawnAttackLookup[us][pos] & board->all;
 
 		return forwardMap | attackMap;
 	}
@@ -418,89 +556,8 @@ namespace chess
 		return kingPseudoLookup[pos];
 	}
 
-	void loadPawnPseudoPushMoves(Bitmap arr[2][64]) {
-		for (int pos = 0; pos < 64; pos++) {
-			Bitmap posMap = bitset[pos];
-			arr[WHITE][pos] = posMap << 8;
-			arr[BLACK][pos] = posMap >> 8;
-		}
-	}
-
-	void loadPawnPseudoAttackMoves(Bitmap arr[2][64]) {
-		for (int pos = 0; pos < 64; pos++) {
-			int col = 7 - pos % 8; // a=0 ... h=7
-			Bitmap posMap = bitset[pos];
-			Bitmap whiteMask = 0, blackMask = 0;
-			if (col != 7) { // not far right
-				whiteMask |= posMap << 7;
-				blackMask |= posMap >> 9;
-			}
-			if (col != 0) { // not far right
-				whiteMask |= posMap << 9;
-				blackMask |= posMap >> 7;
-			}
-			arr[WHITE][pos] = whiteMask;
-			arr[BLACK][pos] = blackMask;
-		}
-	}
-
-	void loadKnightPseudoMoves(Bitmap arr[64]) {
-		for (int pos = 0; pos < 64; pos++) {
-			Bitmap neighbours = 0ULL;
-			int row = 7 - pos / 8, col =7 - pos % 8;
-			if (row < 7) { // not on bottom row
-				if (col < 6) neighbours |= bitset[pos - 10];
-				if (col > 1) neighbours |= bitset[pos - 6];
-			}
-			if (row < 6) { // not second bottom row
-				if (col < 7) neighbours |= bitset[pos - 17];
-				if (col > 0) neighbours |= bitset[pos - 15];
-			}
-			if (row > 0) { // not top row
-				if (col < 6) neighbours |= bitset[pos + 6];
-				if (col > 1) neighbours |= bitset[pos + 10];
-			}
-			if (row > 1) { // not second top row
-				if (col < 7) neighbours |= bitset[pos + 15];
-				if (col > 0) neighbours |= bitset[pos + 17];
-			}
-			arr[pos] = neighbours;
-		}
-	}
-
-	void loadBishopPseudoMoves(MagicLookup arr[64]) {
-		for (int pos = 0; pos < 64; pos++) {
-			arr[pos] = MagicLookup(pos, true);
-		}
-	}
-
-	void loadRookPseudoMoves(MagicLookup arr[64]) {
-		for (int pos = 0; pos < 64; pos++) {
-			arr[pos] = MagicLookup(pos, false);
-		}
-	}
-
-	void loadKingPseudoMoves(Bitmap arr[64]) {
-		for (int pos = 0; pos < 64; pos++) {
-			int row = pos / 8, col = 7 - pos % 8;
-			Bitmap neighbours = 0ULL;
-			if (row > 0) {
-				neighbours |= bitset[pos - 8];
-				if (col > 0)  neighbours |= bitset[pos - 7];
-				if (col < 7)  neighbours |= bitset[pos - 9];
-			}
-			if (row < 7) {
-				neighbours |= bitset[pos + 8];
-				if (col > 0)  neighbours |= bitset[pos + 9];
-				if (col < 7)  neighbours |= bitset[pos + 7];
-			}
-			if (col > 0) neighbours |= bitset[pos + 1];
-			if (col < 7) neighbours |= bitset[pos - 1];
-
-			arr[pos] = neighbours;
-		}
-	}
-
+	template void Generator::getLegalMoves<WHITE>(MoveList* moveList, MoveType type);
+	template void Generator::getLegalMoves<BLACK>(MoveList* moveList, MoveType type);
 
 	MoveList::MoveList() {
 		count = 0u;
@@ -513,7 +570,7 @@ namespace chess
 
 	MoveList::MoveList(Generator& generator, bool onlyCaptures) {
 		count = 0;
-		generator.getLegalMoves(this, onlyCaptures);
+		generator.getLegalMoves(this, onlyCaptures ? MoveType::CAPTURES : MoveType::ALL);
 	}
 
 	void MoveList::add(Move move) {
@@ -521,6 +578,14 @@ namespace chess
 		count++;
 	}
 
+	Move& MoveList::operator[](size_t index) {
+		return moves[index];
+	}
+
+	void MoveList::resize(size_t newSize) {
+		count = newSize;
+	}
+
 	MoveList::iterator MoveList::begin() {
 		return moves;
 	}
@@ -1,4 +1,5 @@
 #include "magics.hpp"
+#include "cpu.hpp"
 
 #include <cstdlib>   // rand
 #include <time.h>    // srand
@@ -7,9 +8,14 @@
 #include <iostream>
 #include <chrono>
 #include <vector>
+#include <string>
+#include <array>
 
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>  // _pext_u64
+#define HAS_PEXT_INTRINSIC
+#endif
 
-#define USE_32_BIT_MULTIPLICATIONS
 
 
 namespace chess
@@ -39,7 +45,7 @@ namespace chess
 			return randomMap() & randomMap() & randomMap();
 		}
 		// pseudo moves ignoring other pieceas
-		Bitmap rmask(int sq) {
+		constexpr Bitmap rmask(int sq) {
 			Bitmap result = 0;
 			int rank = sq / 8, file = sq % 8;
 			for (int r = rank + 1; r < 7; r++) result |= 1ULL << (r * 8 + file);
@@ -49,7 +55,7 @@ namespace chess
 			return result;
 		}
 
-		Bitmap bmask(int sq) {
+		constexpr Bitmap bmask(int sq) {
 			Bitmap result = 0;
 			int rank = sq / 8, file = sq % 8;
 			for (int r = rank + 1, f = file + 1; r < 7 && f < 7; r++, f++) result |= 1ULL << (r * 8 + f);
@@ -59,7 +65,7 @@ namespace chess
 			return result;
 		}
 
-		Bitmap ratt(int sq, Bitmap blockMap) {
+		constexpr Bitmap ratt(int sq, Bitmap blockMap) {
 			Bitmap result = 0;
 			int rank = sq / 8, file = sq % 8;
 
@@ -86,7 +92,7 @@ namespace chess
 			return result;
 		}
 
-		Bitmap batt(int sq, Bitmap blockMap) {
+		constexpr Bitmap batt(int sq, Bitmap blockMap) {
 			Bitmap result = 0;
 			int rank = sq / 8, file = sq % 8;
 
@@ -113,12 +119,17 @@ namespace chess
 			return result;
 		}
 		// transforms a board of blockers by a given magic number
-		size_t transform(Bitmap board, Bitmap magicNum, int numBits) {
-#if defined(USE_32_BIT_MULTIPLICATIONS)
-			return
-				(unsigned)((int)board * (int)magicNum ^ (int)(board >> 32) * (int)(magicNum >> 32)) >> (32 - numBits);
-#else
+		constexpr size_t transform(Bitmap board, Bitmap magicNum, int numBits) {
 			return (board * magicNum) >> (64 - numBits);
+		}
+
+		// transforms a board of blockers by packing the mask's bits together (BMI2 pext)
+		// only call this when cpu::hasPext() is true
+		BMI2_FUNCTION size_t transformPext(Bitmap board, Bitmap mask) {
+#if defined(HAS_PEXT_INTRINSIC)
+			return _pext_u64(board, mask);
+#else
+			return 0;
 #endif
 		}
 
@@ -173,7 +184,7 @@ namespace chess
 			std::cout << "***FAILED*** " << sq << std::endl;
 			return 0ULL;
 		}
-		const int rBits[64] = {
+		constexpr int rBits[64] = {
 			12, 11, 11, 11, 11, 11, 11, 12,
 			11, 10, 10, 10, 10, 10, 10, 11,
 			11, 10, 10, 10, 10, 10, 10, 11,
@@ -184,7 +195,7 @@ namespace chess
 			12, 11, 11, 11, 11, 11, 11, 12
 		};
 
-		const int bBits[64] = {
+		constexpr int bBits[64] = {
 			6, 5, 5, 5, 5, 5, 5, 6,
 			5, 5, 5, 5, 5, 5, 5, 5,
 			5, 5, 7, 7, 7, 7, 5, 5,
@@ -195,19 +206,16 @@ namespace chess
 			6, 5, 5, 5, 5, 5, 5, 6
 		};
 
-		// precomputes all of batt/ratt from a given square
-		// places them in the correct index of a lookup table using magic number
-		std::vector<Bitmap> getLookup(int sq, Bitmap magic, bool isBishop) {
-			Bitmap mask = isBishop ? bmask(sq) : rmask(sq);
-			int numBits = isBishop ? bBits[sq] : rBits[sq];
-			std::vector<Bitmap> lookupTable(MAX_MAGIC_LOOKUP, 0ULL);
-			for (int i = 0; i < (1 << numBits); i++) {
-				Bitmap blockerMask = mapIndex(i, mask);
-				Bitmap attackMask = isBishop ? batt(sq, blockerMask) : ratt(sq, blockerMask);
-				size_t hashIndex = transform(blockerMask, magic, numBits);
-				lookupTable[hashIndex] = attackMask;
+		// offset of a square's slice in the slider attack tables
+		// rook slices come first, followed by every bishop slice
+		constexpr size_t tableOffset(int sq, bool isBishop) {
+			size_t offset = 0;
+			if (isBishop) {
+				for (int i = 0; i < 64; i++) offset += 1ULL << rBits[i];
 			}
-			return lookupTable;
+			const int* bits = isBishop ? bBits : rBits;
+			for (int i = 0; i < sq; i++) offset += 1ULL << bits[i];
+			return offset;
 		}
 
 		void printMagicArrays() {
@@ -239,151 +247,223 @@ namespace chess
 
 
 
-	const Bitmap rMagics[64] = {
-		0x15c00080400020,
-		0x800400008101204,
-		0x402001080100820,
-		0x21104012100102,
-		0x4004000402608,
-		0x2010c40a0808082,
-		0x8044a080110a,
-		0x80560482008081,
-		0x80023002088040,
-		0x240040880520802,
-		0xa28404000004010,
-		0x2a018c00008014,
-		0x140888404210011,
-		0x1802044000008082,
-		0x4300218002108002,
-		0x2c8000c884008081,
-		0x248008400044801,
-		0x880420800082820,
-		0x1089002000200104,
-		0x10842310c011010,
-		0x1400805005a00808,
-		0x2102008080404,
-		0xc1c8180420000202,
-		0x104082c0000101,
-		0x30800200250441,
-		0x204001001010c1a1,
-		0x220108a008041041,
-		0x402880140840204a,
-		0x120960401900806,
-		0x138400000100c9,
-		0x200a000580108142,
-		0x41108200314046,
-		0x40202000439802c0,
-		0x840005090102812,
-		0x680200000001890,
-		0x80180000008a10,
-		0x8102080000040013,
-		0x81002a0300040005,
-		0x4080048060800a01,
-		0x802280811952d3,
-		0x8810040840020030,
-		0x8820200090442810,
-		0x910060d0010024,
-		0x821010020102014,
-		0x202a0005820d1062,
-		0x2200114000841a,
-		0x1403010040010402,
-		0x40101020803281,
-		0x120124000800a40,
-		0xa00020408c1032c0,
-		0x4148004048228110,
-		0x3010008000068008,
-		0x8400202040420801,
-		0x230040400092014,
-		0x40804020080c1121,
-		0x190408010008003,
-		0x1445008280002832,
-		0x2600c601008013,
-		0x100740998001020,
-		0x8828200701010010,
-		0x88528236824426,
-		0x209c01321610100a,
-		0xa480122040608c6,
-		0x1050208140088047,
+	constexpr Bitmap rMagics[64] = {
+		0x4080001040002484,
+		0x4240200610004000,
+		0x2280200248300081,
+		0x1000d0020900089,
+		0x80040002080080,
+		0x230004000a080900,
+		0x90800a0011005080,
+		0x1080002040800d00,
+		0x4802080004002,
+		0x252002100408a04,
+		0xa802001600814020,
+		0x104801802803000,
+		0x1000800045102,
+		0x1800a00840080,
+		0x1001000900020004,
+		0x4001001040a10002,
+		0x80038024400084,
+		0x1890004000600049,
+		0x1084110020014500,
+		0x5000e10010010029,
+		0x120808004001803,
+		0x2001010008240042,
+		0x2010040010010208,
+		0x104e020001009044,
+		0x118400080048021,
+		0x1880200080804000,
+		0x430100200411,
+		0x4010010100104920,
+		0x422006200100804,
+		0x4000020080040080,
+		0xc009008900060004,
+		0x4006030a00008044,
+		0x1681c00022800088,
+		0x1400101002080,
+		0x2002100080802000,
+		0x8808801801000,
+		0xc10a00208a001004,
+		0x100a001042000804,
+		0x400800100800200,
+		0x1000098062000504,
+		0x400020888004,
+		0x5440108100410024,
+		0x400200010008080,
+		0x881001000210008,
+		0x844000800110100,
+		0x8041000a04010008,
+		0xc001021001040088,
+		0x81000088410002,
+		0x4108410180002100,
+		0x808400180200980,
+		0x60500020008480,
+		0x12011048402200,
+		0x8000101800050100,
+		0x42000805100200,
+		0x401000600144300,
+		0x1100404104009200,
+		0x4210042041082,
+		0x8088104004806101,
+		0x4a6000823418052,
+		0x2000100100082005,
+		0x55000800543007,
+		0x1001001400080a01,
+		0x22000408118126,
+		0x8810140500a08242,
 	};
-	const Bitmap bMagics[64] = {
-		0x94808000060408,
-		0x2c902d010021007,
-		0x1020408390423401,
-		0x400900081282a41,
-		0x105a00001011040,
-		0x2400003208188220,
-		0x911b002000010801,
-		0x209845000081209,
-		0x1905040411002008,
-		0x40080600201201c,
-		0x92000601204404,
-		0xa8211c20050020a,
-		0x109008a10001860a,
-		0x1222824100402206,
-		0x820100008001145,
-		0x802910211100021,
-		0x202c309248484020,
-		0x1000a121298c0010,
-		0x202801854209041,
-		0xd22a0001408004c,
-		0x1042080e05104004,
-		0xba10220060802402,
-		0x10402000a030104,
-		0x80844400220101,
-		0x1004411004114191,
-		0x3c05082040080205,
-		0x241820000021100,
-		0x4024100400104104,
-		0x412020000004044,
-		0x4101090000004208,
-		0x4a203008040d208,
-		0x44020040020820,
-		0xa8100000432010,
-		0x450100000008208,
-		0x191048002001082,
-		0xc00c00440022009,
-		0x60408a8008400082,
-		0x2000804524011001,
-		0x40111800408c084,
-		0x5022898c40a0851,
-		0xc004200c20290708,
-		0x1042044881010a90,
-		0x1040a0000401108,
-		0x421608120000012,
-		0x4100a5000000902,
-		0x2090100000a2641,
-		0x1040208008481024,
-		0x2081c020041104,
-		0x412001808040188,
-		0x1118040000004042,
-		0x4488400101001084,
-		0x4092001010504a15,
-		0x254020800010860,
-		0x10201008c05a025,
-		0x2022020000a2001,
-		0x60800000380308,
-		0x80b4840811198401,
-		0x402200010008021,
-		0x12a4141058a00002,
-		0x42020010010811,
-		0x10020200000000b1,
-		0x2210010044004013,
-		0x242a400200861c8,
-		0x22881a000021012,
+	constexpr Bitmap bMagics[64] = {
+		0x4002020208010100,
+		0x171015604004000,
+		0x80804c0801080,
+		0x2098204840200c04,
+		0x410c404020008,
+		0x420882008600000,
+		0x7a310401200a4408,
+		0x200440200822040,
+		0x26280c0484880200,
+		0x20800222020c2101,
+		0x400040800990000,
+		0x1e02482491021410,
+		0x3000040460000000,
+		0x6248a0602620600,
+		0x40802414020210a0,
+		0x454a002104500440,
+		0x4160000802044804,
+		0x10020810010040,
+		0x4200100224c100,
+		0x4108020420202000,
+		0x40820400a00300,
+		0x4084700201100801,
+		0x8044002104021a00,
+		0x810408021180800,
+		0x1291200081030c3,
+		0x9005044c18082808,
+		0x21024000a080200,
+		0x20328000400c010,
+		0x404082004006004,
+		0x602810290806000,
+		0xa0010400c0420822,
+		0x120430820840118,
+		0x410041080204200,
+		0x2608041000020240,
+		0x2020204011800,
+		0x54201100080084,
+		0x400080a0060120,
+		0x48c0810010100,
+		0x324308400220100,
+		0x8210900004041,
+		0x4222010000400,
+		0x280200900401e810,
+		0x1010801001208,
+		0x1000804010400208,
+		0x80901440404,
+		0x210410044a004040,
+		0x4080e040404c0,
+		0x8410148200440087,
+		0x48041018000a,
+		0x440200a208520204,
+		0x482020042084006,
+		0x2500000842020810,
+		0x2000100420820000,
+		0x284081130008000,
+		0x4404600246021160,
+		0x4408080802882008,
+		0x1021004104208200,
+		0xa00448849082028,
+		0xe0d804405c1010,
+		0x104182000c20201,
+		0x10028020604441,
+		0x100006020028088,
+		0x1008200250010104,
+		0x2020040112072200,
 	};
 
-	MagicLookup::MagicLookup(): square(0), isBishop(false), mask(0), magic(0), numBits(0), lookup(std::vector<Bitmap>(0)) {}
+	namespace magicGen
+	{
+		static_assert(tableOffset(63, true) + (1ULL << bBits[63]) == SLIDER_TABLE_SIZE);
+
+		// precomputes all of batt/ratt from every square
+		// places them in the correct index of each square's slice of the table using magic numbers
+		constexpr std::array<Bitmap, SLIDER_TABLE_SIZE> makeSliderAttacks() {
+			std::array<Bitmap, SLIDER_TABLE_SIZE> table{};
+			for (int isBishop = 0; isBishop <= 1; isBishop++) {
+				for (int sq = 0; sq < 64; sq++) {
+					Bitmap mask = isBishop ? bmask(sq) : rmask(sq);
+					Bitmap magic = isBishop ? bMagics[sq] : rMagics[sq];
+					int numBits = isBishop ? bBits[sq] : rBits[sq];
+					size_t offset = tableOffset(sq, isBishop);
+					Bitmap blockerMask = 0;
+					for (int i = 0; i < (1 << numBits); i++) {
+						Bitmap attackMask = isBishop ? batt(sq, blockerMask) : ratt(sq, blockerMask);
+						table[offset + transform(blockerMask, magic, numBits)] = attackMask;
+						blockerMask = (blockerMask - mask) & mask;
+					}
+				}
+			}
+			return table;
+		}
 
-	MagicLookup::MagicLookup(int sq, bool bshp): square(sq), isBishop(bshp) {
-		magic = isBishop ? bMagics[sq] : rMagics[sq];
-		mask = isBishop ? magicGen::bmask(sq) : magicGen::rmask(sq);
-		numBits = isBishop ? magicGen::bBits[sq] : magicGen::rBits[sq];
-		lookup = magicGen::getLookup(sq, magic, isBishop);
+		constexpr std::array<MagicLookup, 64> makeLookups(bool isBishop) {
+			std::array<MagicLookup, 64> lookups;
+			for (int sq = 0; sq < 64; sq++) lookups[sq] = MagicLookup(sq, isBishop);
+			return lookups;
+		}
+	}
+
+	// every rook and bishop attack set, each square using a (1 << numBits) slice
+	// only the magic indexing is built at compile time, so there is one table in the binary
+	alignas(64) constexpr std::array<Bitmap, SLIDER_TABLE_SIZE> magicSliderAttacks = magicGen::makeSliderAttacks();
+	// the same attack sets in pext order, zeroed until loadPextLookups fills it on cpus that use pext
+	alignas(64) Bitmap pextSliderAttacks[SLIDER_TABLE_SIZE];
+	// constant initialised, so lookups are correct (using the magic table) before initPextLookups
+	bool usePextLookups = false;
+
+	// copies the magic table into pext order, which only moves entries rather than recomputing them
+	bool loadPextLookups() {
+		using namespace magicGen;
+		if (!cpu::hasPext()) return false;
+		for (int isBishop = 0; isBishop <= 1; isBishop++) {
+			for (int sq = 0; sq < 64; sq++) {
+				Bitmap mask = isBishop ? bmask(sq) : rmask(sq);
+				Bitmap magic = isBishop ? bMagics[sq] : rMagics[sq];
+				int numBits = isBishop ? bBits[sq] : rBits[sq];
+				size_t offset = tableOffset(sq, isBishop);
+				// walks every subset of mask in increasing order (the same order as mapIndex(i, mask))
+				// so pext packs each blocker map back into i
+				Bitmap blockerMask = 0;
+				for (int i = 0; i < (1 << numBits); i++) {
+					pextSliderAttacks[offset + i] = magicSliderAttacks[offset + transform(blockerMask, magic, numBits)];
+					blockerMask = (blockerMask - mask) & mask;
+				}
+			}
+		}
+		usePextLookups = true;
+		return true;
 	}
-	Bitmap MagicLookup::operator[](Bitmap allBoard) {
+
+	void initPextLookups() {
+		// a function local static fills the table exactly once, even when called from several threads
+		static const bool loaded = loadPextLookups();
+		(void)loaded;
+	}
+
+	constexpr MagicLookup::MagicLookup(int sq, bool isBishop) :
+		mask(isBishop ? magicGen::bmask(sq) : magicGen::rmask(sq)),
+		magic(isBishop ? bMagics[sq] : rMagics[sq]),
+		offset((uint32_t)magicGen::tableOffset(sq, isBishop)),
+		numBits(isBishop ? magicGen::bBits[sq] : magicGen::rBits[sq]) {}
+
+	Bitmap MagicLookup::operator[](Bitmap allBoard) const {
+		if (usePextLookups) return pextSliderAttacks[offset + magicGen::transformPext(allBoard, mask)];
+
 		Bitmap blockers = mask & allBoard;
 		size_t ind = magicGen::transform(blockers, magic, numBits);
-		return lookup[ind];
+		return magicSliderAttacks[offset + ind];
 	}
 
+	constexpr std::array<MagicLookup, 64> bishopPseudoLookup = magicGen::makeLookups(true);
+	constexpr std::array<MagicLookup, 64> rookPseudoLookup = magicGen::makeLookups(false);
+
 }
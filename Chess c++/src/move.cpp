@@ -3,52 +3,6 @@
 
 namespace chess
 {
-	// takes either knight, bishop, rook, queen and squashes it to the first 2 bits
-	int pieceToPromotionCode(Type piece) {
-		if (piece < 1) return 0;
-		return piece - 1;
-	}
-
-	Move makeMove(int start, int end){
-		return (Move)start | (end << 6);
-	}
-
-	Move makeMove(int start, int end, Flag flag, Type promotion) {
-		return start | (end << 6) | ((int)flag << 12) | (pieceToPromotionCode(promotion) << 14);
-	}
-
-	Move makePromotion(int start, int end, Type piece)
-	{
-		return makeMove(start, end, Flag::PROMOTION, piece);
-	}
-
-	Move makeEnPassant(int start, int end)
-	{
-		return makeMove(start, end, Flag::EN_PASSANT, PAWN);
-	}
-
-	Move makeCastle(int start, int end)
-	{
-		return makeMove(start, end, Flag::CASTLE, PAWN);
-	}
-
-	int getStart(Move move) {
-		return move & 0b111111;;
-	}
-
-	int getEnd(Move move) {
-		return (move >> 6) & 0b111111;
-	}
-
-	Flag getFlag(Move move) {
-		return (Flag)(move>>12 & 0b11);
-	}
-
-	Type getPromotion(Move move) {
-		return ((move >> 14) & 0b11) + 1;
-	}
-
-
 	std::string notate(Move move)
 	{
 		int startPos = getStart(move);
@@ -10,11 +10,7 @@ namespace chess
 		int value = 0;
 		bool capture = bitset[getEnd(move)] & board.teamMaps[!board.colour];
 		if (capture) {
-			Type startPiece, endPiece;
-			for (Type piece = PAWN; piece <= KING; piece++) {
-				if (bitset[getStart(move)] & board.positions[board.colour][piece]) startPiece = piece;
-				if (bitset[getEnd(move)] & board.positions[!board.colour][piece]) endPiece = piece;
-			}
+			Type startPiece = board.pieceOn(getStart(move)), endPiece = board.pieceOn(getEnd(move));
 			value += pieceWorths[endPiece] - pieceWorths[startPiece] / 10;
 		}
 		
@@ -22,8 +18,8 @@ namespace chess
 			value += pieceWorths[getPromotion(move)];
 		}
 
-		Move hashMove = tt[board.zobrist].move;
-		if (hashMove == move) {
+		TTEntry entry = tt[board.zobrist];
+		if (entry.zobrist == board.zobrist && entry.move == move) {
 			value += 10000;
 		}
 
@@ -43,4 +39,120 @@ namespace chess
 			moves.add(move);
 		}
 	}
+
+	MovePicker::MovePicker(Board& pboard, Move hashMove, const Move killerMoves[2]) : board(pboard), generator(pboard) {
+		stage = Stage::HASH_MOVE;
+		this->hashMove = hashMove;
+		killers[0] = killerMoves[0];
+		killers[1] = killerMoves[1];
+		killerIndex = 0;
+		current = 0;
+
+		// nothing is generated yet, the masks are all that is needed to check the hash move
+		generator.loadMasks();
+	}
+
+	bool MovePicker::isCapture(Move move) {
+		return (bitset[getEnd(move)] & board.teamMaps[!board.colour]) || getFlag(move) == Flag::EN_PASSANT;
+	}
+
+	void MovePicker::scoreCaptures() {
+		size_t goodCount = 0;
+		for (Move move : moves) {
+			Type startPiece = board.pieceOn(getStart(move));
+			// en passant lands on an empty position
+			Type endPiece = getFlag(move) == Flag::EN_PASSANT ? (Type)PAWN : board.pieceOn(getEnd(move));
+			int value = pieceWorths[endPiece] - pieceWorths[startPiece] / 10;
+			if (getFlag(move) == Flag::PROMOTION) value += pieceWorths[getPromotion(move)];
+
+			// taking a cheaper piece that is defended probably loses material
+			bool losing = pieceWorths[endPiece] < pieceWorths[startPiece] && generator.isAttacked(getEnd(move));
+			if (losing && getFlag(move) != Flag::PROMOTION) {
+				badCaptures.add(move);
+				continue;
+			}
+			moves[goodCount] = move;
+			scores[goodCount] = value;
+			goodCount++;
+		}
+		// only the good captures are left at the front
+		moves.resize(goodCount);
+	}
+
+	void MovePicker::scoreQuiets() {
+		for (size_t i = 0; i < moves.size(); i++) {
+			scores[i] = getFlag(moves[i]) == Flag::PROMOTION ? pieceWorths[getPromotion(moves[i])] : 0;
+		}
+	}
+
+	Move MovePicker::pickBest() {
+		size_t best = current;
+		for (size_t i = current + 1; i < moves.size(); i++) {
+			if (scores[i] > scores[best]) best = i;
+		}
+		std::swap(moves[current], moves[best]);
+		std::swap(scores[current], scores[best]);
+		return moves[current++];
+	}
+
+	Move MovePicker::next() {
+		switch (stage) {
+		case Stage::HASH_MOVE:
+			stage = Stage::GENERATE_CAPTURES;
+			if (generator.isLegal(hashMove)) return hashMove;
+			[[fallthrough]];
+
+		case Stage::GENERATE_CAPTURES:
+			generator.getLoadedMoves(&moves, MoveType::CAPTURES);
+			scoreCaptures();
+			stage = Stage::GOOD_CAPTURES;
+			[[fallthrough]];
+
+		case Stage::GOOD_CAPTURES:
+			while (current < moves.size()) {
+				Move move = pickBest();
+				if (move != hashMove) return move;
+			}
+			stage = Stage::KILLERS;
+			[[fallthrough]];
+
+		case Stage::KILLERS:
+			while (killerIndex < 2) {
+				Move killer = killers[killerIndex++];
+				if (killer == hashMove || isCapture(killer)) continue;
+				if (generator.isLegal(killer)) return killer;
+			}
+			stage = Stage::GENERATE_QUIETS;
+			[[fallthrough]];
+
+		case Stage::GENERATE_QUIETS:
+			moves.clear();
+			current = 0;
+			generator.getLoadedMoves(&moves, MoveType::QUIETS);
+			scoreQuiets();
+			stage = Stage::QUIETS;
+			[[fallthrough]];
+
+		case Stage::QUIETS:
+			while (current < moves.size()) {
+				Move move = pickBest();
+				if (move != hashMove && move != killers[0] && move != killers[1]) return move;
+			}
+			stage = Stage::BAD_CAPTURES;
+			current = 0;
+			[[fallthrough]];
+
+		case Stage::BAD_CAPTURES:
+			while (current < badCaptures.size()) {
+				Move move = badCaptures[current++];
+				if (move != hashMove) return move;
+			}
+			stage = Stage::DONE;
+			[[fallthrough]];
+
+		case Stage::DONE:
+			break;
+		}
+		return NULL_MOVE;
+	}
 }
\ No newline at end of file
@@ -16,15 +16,15 @@ struct Test {
 };
 
 Test tests[] = {
-	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNRwKQkq - 0 1", 5, 4865609},
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
 	{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -", 4, 4085603},
 	{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", 6, 11030083},
 	{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292},
 	{"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194}
 };
 
-Test startpos6 = { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNRwKQkq - 0 1", 6, 119060324 };
-Test startpos7 = { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNRwKQkq - 0 1", 7, 3195901860ll };
+Test startpos6 = { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324 };
+Test startpos7 = { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 7, 3195901860ll };
 
 
 Board board;
@@ -60,6 +60,39 @@ long long perft(int depth, bool printMoves = true) {
 	return nodeCount;
 }
 
+// perft using copy-make (Position::afterMove) instead of makeMove and unmakeMove
+long long perftCopy(Position& position, int depth) {
+	Generator positionGenerator(position);
+	MoveList moves(positionGenerator);
+	if (depth == 1) return (long long)moves.size();
+
+	long long nodeCount = 0;
+	for (Move move : moves) {
+		Position next = position.afterMove(move);
+		nodeCount += perftCopy(next, depth - 1);
+	}
+	return nodeCount;
+}
+
+// times make/unmake against copy-make on the same test
+void runBenchmark(Test test) {
+	board = Board::fromFen(test.fen);
+	auto t0 = std::chrono::high_resolution_clock::now();
+	long long makeNodes = perft(test.depth, false);
+	auto t1 = std::chrono::high_resolution_clock::now();
+	Position position = board;
+	long long copyNodes = perftCopy(position, test.depth);
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	double makeElapsed = (double)std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() / 1000;
+	double copyElapsed = (double)std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() / 1000;
+
+	std::cout << "make/unmake " << makeElapsed << "s, copy-make " << copyElapsed << "s ";
+	if (makeNodes == test.expected && copyNodes == test.expected) std::cout << "PASSED ";
+	else std::cout << "FAILED ";
+	std::cout << std::endl;
+}
+
 void runPerft(Test test, bool printMoves=true) {
 	auto t0 = std::chrono::high_resolution_clock::now();
 	int depth = test.depth;
@@ -84,5 +117,6 @@ void runPerft(Test test, bool printMoves=true) {
 
 int main() {
 	for (Test test : tests) runPerft(test, false);
+	for (Test test : tests) runBenchmark(test);
 	
 }
\ No newline at end of file
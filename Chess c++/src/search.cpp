@@ -5,6 +5,12 @@
 #include <iostream>
 #include <stdlib.h>
 #include <chrono>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <array>
+#include <cmath>
 
 std::string formatToCommas(std::string s) {
 	int n = (int)s.size() - 3;
@@ -23,6 +29,9 @@ namespace chess
 
 	const int DEFAULT_TIME = 1000; // milliseconds
 
+	// calls to shouldFinishSearch per clock read, reading it every node is slow
+	const int TIME_CHECK_INTERVAL = 1024;
+
 	const size_t TRANSPOSITION_SIZE = 9999999;
 
 	const int POSITIVE_INFINITY = 99999999;
@@ -30,48 +39,112 @@ namespace chess
 
 	const int CHECKMATE_SCORE = -9999999;
 
-	Bot::Bot(): tt(TRANSPOSITION_SIZE) {
-		maxSearchTime = DEFAULT_TIME;
+	// half the width of the first aspiration window around the last iteration's eval
+	const int ASPIRATION_WINDOW = 30;
+	// iterations before this depth are too unstable to narrow the window
+	const int ASPIRATION_MIN_DEPTH = 4;
+	// windows wider than this are opened all the way
+	const int MAX_ASPIRATION_WINDOW = 1000;
+
+	// shallowest depth that tries null move pruning
+	const int NULL_MOVE_MIN_DEPTH = 3;
+	// depth from which a null move cutoff is checked with a real reduced search, in case of zugzwang
+	const int NULL_MOVE_VERIFY_DEPTH = 8;
+
+	// shallowest depth that reduces late moves
+	const int LMR_MIN_DEPTH = 3;
+	// moves searched at full depth before late moves are reduced
+	const int LMR_FULL_DEPTH_MOVES = 3;
+	// history score above which a quiet move is reduced less
+	const int GOOD_HISTORY = MAX_HISTORY / 4;
+
+	bool isMateScore(int score) {
+		return score <= CHECKMATE_SCORE + MAX_SEARCH_DEPTH || score >= -CHECKMATE_SCORE - MAX_SEARCH_DEPTH;
+	}
+
+	// mate scores count plies from the root, but the table is shared between plies
+	// so they are stored counting plies from the entry's own position instead
+	int scoreToTT(int score, int ply) {
+		if (score <= CHECKMATE_SCORE + MAX_SEARCH_DEPTH) return score - ply;
+		if (score >= -CHECKMATE_SCORE - MAX_SEARCH_DEPTH) return score + ply;
+		return score;
+	}
+
+	int scoreFromTT(int score, int ply) {
+		if (score <= CHECKMATE_SCORE + MAX_SEARCH_DEPTH) return score + ply;
+		if (score >= -CHECKMATE_SCORE - MAX_SEARCH_DEPTH) return score - ply;
+		return score;
+	}
+
+	SearchThread::SearchThread(const Board& rootBoard) : board(rootBoard), generator(board) {
+		bestRootMove = NULL_MOVE;
+		bestRootEval = NEGATIVE_INFINITY;
+		std::fill(&killers[0][0], &killers[0][0] + MAX_KILLER_PLY * 2, NULL_MOVE);
 		nodes = 0;
 		evalCount = 0;
+		transposCount = 0;
+		timeCheckCount = 0;
+		nullMoveMinPly = 0;
+		std::fill(&history[0][0][0], &history[0][0][0] + 2 * 64 * 64, 0);
+	}
+
+	Bot::Bot(): tt(TRANSPOSITION_SIZE) {
+		maxSearchTime = DEFAULT_TIME;
 		runQuiescence = false;
+		threadCount = 1;
 	}
 
-	Bot::Bot(double searchTime, bool quies) : tt(TRANSPOSITION_SIZE), runQuiescence(quies) {
+	Bot::Bot(double searchTime, bool quies, int threads) : tt(TRANSPOSITION_SIZE), runQuiescence(quies) {
 		maxSearchTime = searchTime;
-		nodes = 0;
-		evalCount = 0;
+		threadCount = std::max(threads, 1);
 	}
 
 	Move Bot::search(Board board) {
 		//tt.clear();
 
-		evalCount = 0;
-		transposCount = 0;
-		nodes = 0;
-		searchStartTime = std::chrono::system_clock::now();
+		stopSearch = false;
+		searchStartTime = std::chrono::steady_clock::now();
+
+		// each thread needs its own board and heuristics, held by pointer as generators point at their board
+		std::vector<std::unique_ptr<SearchThread>> threads;
+		for (int i = 0; i < threadCount; i++) threads.push_back(std::make_unique<SearchThread>(board));
+
+		std::vector<std::thread> helpers;
+		for (int i = 1; i < threadCount; i++) {
+			helpers.emplace_back(&Bot::helperSearch, this, std::ref(*threads[i]), i);
+		}
 
-		generator = Generator(board);
+		// the main thread's search is the one reported
+		SearchThread& mainThread = *threads[0];
 		int searchDepth = 1;
 
 		Move bestMove = NULL_MOVE;
 		int bestEval = NEGATIVE_INFINITY;
 		for (; searchDepth <= MAX_SEARCH_DEPTH; searchDepth++) {
-			searchRoot(board, searchDepth);
+			aspirationSearch(mainThread, searchDepth);
 
-			if (bestRootMove != NULL_MOVE) {
-				bestMove = bestRootMove;
-				bestEval = bestRootEval;
+			if (mainThread.bestRootMove != NULL_MOVE) {
+				bestMove = mainThread.bestRootMove;
+				bestEval = mainThread.bestRootEval;
 				std::cout << "depth: " << searchDepth << '\r';
 				std::cout.flush();
 			}
 
-			if (shouldFinishSearch()) {
+			if (checkTime()) {
 				break;
 			}
 		}
+		stopSearch = true;
+		for (std::thread& helper : helpers) helper.join();
 		std::cout << std::endl;
 
+		int nodes = 0, evalCount = 0, transposCount = 0;
+		for (const auto& thread : threads) {
+			nodes += thread->nodes;
+			evalCount += thread->evalCount;
+			transposCount += thread->transposCount;
+		}
+
 		if (board.colour == BLACK) bestEval = -bestEval;
 
 		std::cout << "move: " << notate(bestMove) << std::endl;
@@ -87,115 +160,296 @@ namespace chess
 		return bestMove;
 	}
 
-	void Bot::searchRoot(Board& board, int depth) {
-		MoveList moves(generator);
+	void Bot::helperSearch(SearchThread& thread, int index) {
+		// odd helpers start a depth ahead so that threads aren't all on the same iteration
+		for (int searchDepth = 1 + index % 2; searchDepth <= MAX_SEARCH_DEPTH; searchDepth++) {
+			aspirationSearch(thread, searchDepth);
+			if (checkTime()) return;
+		}
+	}
+
+	void Bot::aspirationSearch(SearchThread& thread, int depth) {
+		int previousEval = thread.bestRootEval;
+		if (depth < ASPIRATION_MIN_DEPTH || isMateScore(previousEval)) {
+			searchRoot(thread, depth, NEGATIVE_INFINITY, POSITIVE_INFINITY);
+			return;
+		}
+
+		int window = ASPIRATION_WINDOW;
+		int alpha = previousEval - window;
+		int beta = previousEval + window;
+		while (true) {
+			searchRoot(thread, depth, alpha, beta);
+			if (shouldFinishSearch(thread)) return;
+
+			// widen whichever side the eval fell outside of and search again
+			window *= 2;
+			if (thread.bestRootEval <= alpha)     alpha = window > MAX_ASPIRATION_WINDOW ? NEGATIVE_INFINITY : previousEval - window;
+			else if (thread.bestRootEval >= beta) beta = window > MAX_ASPIRATION_WINDOW ? POSITIVE_INFINITY : previousEval + window;
+			else return;
+		}
+	}
+
+	void Bot::searchRoot(SearchThread& thread, int depth, int alpha, int beta) {
+		Board& board = thread.board;
+		MoveList moves(thread.generator);
 
 		order(board, moves, tt);
 
-		nodes += (int)moves.size();
+		thread.nodes += (int)moves.size();
 
-		bestRootMove = NULL_MOVE;
-		bestRootEval = NEGATIVE_INFINITY;
+		thread.bestRootMove = NULL_MOVE;
+		thread.bestRootEval = NEGATIVE_INFINITY;
 
+		int originalAlpha = alpha;
+		bool firstMove = true;
 		for (Move move : moves) {
 
 			board.makeMove(move);
-			int score = -negamax(board, depth - 1, NEGATIVE_INFINITY, POSITIVE_INFINITY);
+			int score = principalVariationSearch(thread, depth - 1, 1, alpha, beta, firstMove);
 			board.unmakeMove(move);
+			firstMove = false;
 
-			if (shouldFinishSearch()) return;
+			if (shouldFinishSearch(thread)) return;
 
-			if (score > bestRootEval) {
-				bestRootEval = score;
-				bestRootMove = move;
+			if (score > thread.bestRootEval) {
+				thread.bestRootEval = score;
+				thread.bestRootMove = move;
 			}
+			if (score > alpha) alpha = score;
+			if (score >= beta) break;
 		}
 
-		tt.replace({ board.zobrist, depth, bestRootMove, bestRootEval, NodeType::EXACT});
+		NodeType nodeType = NodeType::EXACT;
+		if (thread.bestRootEval <= originalAlpha) nodeType = NodeType::UPPER;
+		else if (thread.bestRootEval >= beta)     nodeType = NodeType::LOWER;
+		tt.replace({ board.zobrist, depth, thread.bestRootMove, thread.bestRootEval, nodeType});
+	}
+
+	int Bot::principalVariationSearch(SearchThread& thread, int depth, int ply, int alpha, int beta, bool fullWindow) {
+		if (fullWindow) return -negamax(thread, depth, ply, -beta, -alpha);
+
+		// a null window only finds whether the move beats alpha, which is cheap when it doesn't
+		int score = -negamax(thread, depth, ply, -alpha - 1, -alpha);
+		if (score > alpha && score < beta) score = -negamax(thread, depth, ply, -beta, -alpha);
+		return score;
 	}
 
 	
 
-	int Bot::negamax(Board& board, int depth, int alpha, int beta) {
-		
-		if (tt.contains(board.zobrist, depth, alpha, beta)) {
-			transposCount++;
-			return tt[board.zobrist].value;
+	int Bot::negamax(SearchThread& thread, int depth, int ply, int alpha, int beta) {
+		Board& board = thread.board;
+
+		// draws are checked before the transposition table since its entries don't know the move history
+		if (board.isRepetition(ply) || board.isFiftyMoveDraw()) return 0;
+
+		// a draw is available by repeating, so this node is worth at least a draw
+		if (alpha < 0 && board.hasUpcomingRepetition(ply)) {
+			alpha = 0;
+			if (alpha >= beta) return alpha;
+		}
+
+		int ttValue;
+		if (tt.contains(board.zobrist, depth, scoreToTT(alpha, ply), scoreToTT(beta, ply), &ttValue)) {
+			thread.transposCount++;
+			return scoreFromTT(ttValue, ply);
 		}
 
-		if (shouldFinishSearch()) return alpha;
+		if (shouldFinishSearch(thread)) return alpha;
 
 		if (depth == 0) {
-			int eval;
-			if (runQuiescence) eval = quiescence(board, depth, alpha, beta);
-			else {
-				evalCount++;
-				eval = evaluate(board);
-			}
+			// quiescence stores its own bounds
+			if (runQuiescence) return quiescence(thread, depth, ply, alpha, beta);
+			thread.evalCount++;
+			int eval = evaluate(board);
 			tt.replace({ board.zobrist, depth, NULL_MOVE, eval, NodeType::EXACT});
 			return eval;
 		}
 
-		MoveList moves(generator);
-		
-		if (moves.size() == 0) {
-			if (generator.isCheck()) return CHECKMATE_SCORE - depth; // subtract depth to favour mates in shorter time spans
-			else return 0;
-		}
+		int nullScore;
+		if (tryNullMove(thread, depth, ply, alpha, beta, &nullScore)) return nullScore;
 
-		order(board, moves, tt);
+		TTEntry entry = tt[board.zobrist];
+		Move hashMove = entry.zobrist == board.zobrist ? entry.move : NULL_MOVE;
+		const Move noKillers[2] = { NULL_MOVE, NULL_MOVE };
+		MovePicker picker(board, hashMove, ply < MAX_KILLER_PLY ? thread.killers[ply] : noKillers);
 
-		NodeType nodeType = NodeType::LOWER;
+		// an upper bound until a move beats alpha
+		NodeType nodeType = NodeType::UPPER;
 
 		int bestEval = NEGATIVE_INFINITY;
 		Move bestMove = NULL_MOVE;
+		int moveCount = 0;
+		bool isPrincipalVariation = beta - alpha > 1;
+		bool inCheck = board.isCheck();
+		// quiet moves that didn't cause a cutoff, their history is lowered if a later move does
+		MoveList quietsTried;
+
+		for (Move move = picker.next(); move != NULL_MOVE; move = picker.next()) {
+			thread.nodes++;
+			moveCount++;
+			bool isQuiet = !(bitset[getEnd(move)] & board.teamMaps[!board.colour]) && getFlag(move) != Flag::EN_PASSANT;
+			bool canReduce = isQuiet && !inCheck && getFlag(move) != Flag::PROMOTION
+				&& depth >= LMR_MIN_DEPTH && moveCount > LMR_FULL_DEPTH_MOVES;
+			Colour movingColour = board.colour;
 
-		for (Move move : moves) {
-			nodes++;
 			board.makeMove(move);
-			int score = -negamax(board, depth - 1, -beta, -alpha);
+			int score;
+			int reduction = canReduce ? lateMoveReduction(thread, move, movingColour, depth, ply, moveCount, isPrincipalVariation) : 0;
+			if (reduction > 0) {
+				score = -negamax(thread, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+				// the reduced search may have missed something, so search it properly when it beats alpha
+				if (score > alpha) score = principalVariationSearch(thread, depth - 1, ply + 1, alpha, beta, false);
+			}
+			else score = principalVariationSearch(thread, depth - 1, ply + 1, alpha, beta, moveCount == 1);
 			board.unmakeMove(move);
 
-			if (shouldFinishSearch()) return bestEval;
+			if (shouldFinishSearch(thread)) return bestEval;
 
 			if (score >= beta) {
-				nodeType = NodeType::UPPER;
+				nodeType = NodeType::LOWER;
 				bestEval = beta;
 				bestMove = move;
+				if (isQuiet) {
+					storeKiller(thread, ply, move);
+					updateHistory(thread, board.colour, move, depth * depth);
+					for (Move quiet : quietsTried) updateHistory(thread, board.colour, quiet, -depth * depth);
+				}
 				break;
 			}
+			if (isQuiet) quietsTried.add(move);
 			if (score > bestEval) {
-				nodeType = NodeType::EXACT;
 				bestEval = score;
 				bestMove = move;
 				if (score > alpha) {
+					nodeType = NodeType::EXACT;
 					alpha = score;
 				}
 			}
 		}
 
-		tt.replace({ board.zobrist, depth, bestMove, bestEval, nodeType});
+		if (moveCount == 0) {
+			if (board.isCheck()) return CHECKMATE_SCORE + ply; // add ply to favour mates in shorter time spans
+			else return 0;
+		}
+
+		tt.replace({ board.zobrist, depth, bestMove, scoreToTT(bestEval, ply), nodeType});
 		return bestEval;
 	}
 
-	int Bot::quiescence(Board& board, int depth, int alpha, int beta) {
-		if (tt.contains(board.zobrist, depth, alpha, beta)) {
-			transposCount++;
-			return tt[board.zobrist].value;
+	bool Bot::tryNullMove(SearchThread& thread, int depth, int ply, int alpha, int beta, int* score) {
+		Board& board = thread.board;
+		bool isPrincipalVariation = beta - alpha > 1;
+		// zugzwang is likely with only pawns left, where passing would be better than any move
+		bool hasPieces = board.positions[board.colour][KNIGHT] | board.positions[board.colour][BISHOP]
+			| board.positions[board.colour][ROOK] | board.positions[board.colour][QUEEN];
+		// pliesFromNull stops two null moves in a row, which would just search the same position shallower
+		if (isPrincipalVariation || depth < NULL_MOVE_MIN_DEPTH || ply < thread.nullMoveMinPly || board.pliesFromNull == 0
+			|| board.isCheck() || !hasPieces || isMateScore(beta)) return false;
+
+		thread.evalCount++;
+		int staticEval = evaluate(board);
+		if (staticEval < beta) return false;
+
+		// reduce more at higher depths and when further ahead of beta
+		int reduction = 3 + depth / 4 + std::min((staticEval - beta) / 200, 2);
+		int nullDepth = std::max(depth - 1 - reduction, 0);
+
+		board.makeNullMove();
+		int nullScore = -negamax(thread, nullDepth, ply + 1, -beta, -beta + 1);
+		board.unmakeNullMove();
+
+		if (nullScore < beta || shouldFinishSearch(thread)) return false;
+		// a mate found after passing isn't proven
+		if (isMateScore(nullScore)) nullScore = beta;
+
+		if (depth >= NULL_MOVE_VERIFY_DEPTH) {
+			// search the position itself without null moves for a while, which fails low in zugzwang
+			// restored afterwards rather than cleared, this may be inside another verification search
+			int previousMinPly = thread.nullMoveMinPly;
+			thread.nullMoveMinPly = ply + 3 * nullDepth / 4;
+			int verifyScore = negamax(thread, nullDepth, ply, beta - 1, beta);
+			thread.nullMoveMinPly = previousMinPly;
+			if (verifyScore < beta) return false;
 		}
 
-		evalCount++;
-		int currentEval = evaluate(board);
+		*score = nullScore;
+		return true;
+	}
 
-		if (currentEval >= beta) {
-			tt.replace({ board.zobrist, depth, NULL_MOVE, currentEval, NodeType::LOWER});
-			return currentEval;
+	int Bot::lateMoveReduction(const SearchThread& thread, Move move, Colour colour, int depth, int ply, int moveCount, bool isPrincipalVariation) {
+		// reductions[depth][move number], growing with the log of both
+		// std::log isn't constexpr, so this is built on the first call rather than at start up
+		static const auto reductions = [] {
+			std::array<std::array<int, 64>, 64> table{};
+			for (int depth = 1; depth < 64; depth++) {
+				for (int moveNumber = 1; moveNumber < 64; moveNumber++) {
+					table[depth][moveNumber] = (int)(0.75 + std::log(depth) * std::log(moveNumber) / 2.25);
+				}
+			}
+			return table;
+		}();
+
+		const Board& board = thread.board;
+		int reduction = reductions[std::min(depth, 63)][std::min(moveCount, 63)];
+
+		// moves that are more likely to be good are reduced less
+		if (isPrincipalVariation) reduction--;
+		if (board.isCheck()) reduction--;
+		if (ply < MAX_KILLER_PLY && (thread.killers[ply][0] == move || thread.killers[ply][1] == move)) reduction--;
+		if (thread.history[colour][getStart(move)][getEnd(move)] > GOOD_HISTORY) reduction--;
+
+		// always leave at least 1 ply to search
+		return std::clamp(reduction, 0, depth - 2);
+	}
+
+	void Bot::updateHistory(SearchThread& thread, Colour colour, Move move, int bonus) {
+		int& entry = thread.history[colour][getStart(move)][getEnd(move)];
+		// pulls the entry towards +-MAX_HISTORY so that it stays in range however often it is updated
+		entry += bonus - entry * std::abs(bonus) / MAX_HISTORY;
+	}
+
+	void Bot::storeKiller(SearchThread& thread, int ply, Move move) {
+		if (ply >= MAX_KILLER_PLY || thread.killers[ply][0] == move) return;
+		thread.killers[ply][1] = thread.killers[ply][0];
+		thread.killers[ply][0] = move;
+	}
+
+	int Bot::quiescence(SearchThread& thread, int depth, int ply, int alpha, int beta) {
+		Board& board = thread.board;
+		Generator& generator = thread.generator;
+		int ttValue;
+		if (tt.contains(board.zobrist, depth, scoreToTT(alpha, ply), scoreToTT(beta, ply), &ttValue)) {
+			thread.transposCount++;
+			return scoreFromTT(ttValue, ply);
 		}
-		if (currentEval > alpha) {
-			alpha = currentEval;
+
+		bool inCheck = board.isCheck();
+		int originalAlpha = alpha;
+
+		// there is no standing pat when in check, every evasion has to be searched
+		int currentEval = CHECKMATE_SCORE + ply;
+		if (!inCheck) {
+			thread.evalCount++;
+			currentEval = evaluate(board);
+
+			if (currentEval >= beta) {
+				tt.replace({ board.zobrist, depth, NULL_MOVE, scoreToTT(currentEval, ply), NodeType::LOWER});
+				return currentEval;
+			}
+			if (currentEval > alpha) {
+				alpha = currentEval;
+			}
 		}
 
-		MoveList moves(generator, true);
+		generator.loadMasks();
+		MoveList moves;
+		if (inCheck) generator.getLoadedMoves(&moves, MoveType::ALL);
+		else {
+			generator.getLoadedMoves(&moves, MoveType::CAPTURES);
+			// quiet checks only on the first ply so that the search still ends
+			if (depth == 0) generator.getLoadedMoves(&moves, MoveType::QUIET_CHECKS);
+		}
 
 		if (moves.size() == 0) {
 			return currentEval;
@@ -203,18 +457,19 @@ namespace chess
 
 		order(board, moves, tt);
 
-		NodeType nodeType = NodeType::LOWER;
+		// exact when standing pat already beat alpha
+		NodeType nodeType = alpha > originalAlpha ? NodeType::EXACT : NodeType::UPPER;
 
 		Move bestMove = NULL_MOVE;
 
 		for (Move move : moves) {
-			nodes++;
+			thread.nodes++;
 			board.makeMove(move);
-			int score = -quiescence(board, depth, -beta, -alpha);
+			int score = -quiescence(thread, depth - 1, ply + 1, -beta, -alpha);
 			board.unmakeMove(move);
 
 			if (score >= beta) {
-				nodeType = NodeType::UPPER;
+				nodeType = NodeType::LOWER;
 				alpha = beta;
 				break;
 			}
@@ -225,14 +480,22 @@ namespace chess
 			}
 		}
 
-		TTEntry entry = { board.zobrist, depth, bestMove, alpha, nodeType };
+		TTEntry entry = { board.zobrist, depth, bestMove, scoreToTT(alpha, ply), nodeType };
 		tt.replace(entry);
 
 		return alpha;
 	}
 
-	bool Bot::shouldFinishSearch() {
+	bool Bot::checkTime() {
 		using namespace std::chrono;
-		return duration_cast<milliseconds>(system_clock::now() - searchStartTime).count() > maxSearchTime;
+		if (duration_cast<milliseconds>(steady_clock::now() - searchStartTime).count() > maxSearchTime) stopSearch = true;
+		return stopSearch.load(std::memory_order_relaxed);
+	}
+
+	bool Bot::shouldFinishSearch(SearchThread& thread) {
+		if (stopSearch.load(std::memory_order_relaxed)) return true;
+		if (++thread.timeCheckCount < TIME_CHECK_INTERVAL) return false;
+		thread.timeCheckCount = 0;
+		return checkTime();
 	}
 }
\ No newline at end of file
@@ -5,47 +5,66 @@
 namespace chess
 {
 
+	static uint64_t packEntry(const TTEntry& entry) {
+		return (uint64_t)entry.move.value
+			| (uint64_t)(uint32_t)entry.value << 16
+			| (uint64_t)(entry.depth & 0x3fff) << 48
+			| (uint64_t)entry.nodeType << 62;
+	}
+
+	static TTEntry unpackEntry(uint64_t key, uint64_t data) {
+		TTEntry entry;
+		entry.zobrist = key ^ data;
+		entry.move = Move((uint16_t)data);
+		entry.value = (int32_t)(uint32_t)(data >> 16);
+		entry.depth = (int)((int64_t)(data << 2) >> 50); // sign extends the 14 depth bits
+		entry.nodeType = (NodeType)(data >> 62);
+		return entry;
+	}
+
 	TranspositionTable::TranspositionTable(size_t tableSize) {
 		size = tableSize;
-		table = new TTEntry[size];
-		std::memset(table, 0, sizeof(TTEntry) * size);
+		table = new TTSlot[size];
+		clear();
 	}
 
 	TranspositionTable::~TranspositionTable() {
 		delete[] table;
 	}
 
-	TTEntry& TranspositionTable::operator[](Zobrist zobrist) {
-		return table[zobrist % size];
+	TTEntry TranspositionTable::operator[](Zobrist zobrist) const {
+		const TTSlot& slot = table[zobrist % size];
+		return unpackEntry(slot.key.load(std::memory_order_relaxed), slot.data.load(std::memory_order_relaxed));
 	}
 
-	bool TranspositionTable::contains(Zobrist zobrist, int depth, int alpha, int beta) {
-		TTEntry entry = table[zobrist % size];
+	bool TranspositionTable::contains(Zobrist zobrist, int depth, int alpha, int beta, int* value) {
+		TTEntry entry = (*this)[zobrist];
 		if (entry.zobrist != zobrist || entry.depth < depth ||
 			(entry.nodeType == NodeType::LOWER && entry.value < beta) ||
 			(entry.nodeType == NodeType::UPPER && entry.value > alpha))
 			return false;
+		*value = entry.value;
 		return true;
 	}
 
 	void TranspositionTable::replace(TTEntry entry) {
-		(*this)[entry.zobrist] = entry;
-		return;
-		if ((*this)[entry.zobrist].depth <= entry.depth) {
-			(*this)[entry.zobrist] = entry;
-		}
+		TTSlot& slot = table[entry.zobrist % size];
+		uint64_t data = packEntry(entry);
+		slot.key.store(entry.zobrist ^ data, std::memory_order_relaxed);
+		slot.data.store(data, std::memory_order_relaxed);
 	}
 
 	void TranspositionTable::clear() {
-		std::memset(table, 0, sizeof(TTEntry) * size);
+		for (size_t i = 0; i < size; i++) {
+			table[i].key.store(0, std::memory_order_relaxed);
+			table[i].data.store(0, std::memory_order_relaxed);
+		}
 	}
 
 	double TranspositionTable::percentFull() {
-		TTEntry empty;
-		std::memset(&empty, 0, sizeof(TTEntry));
 		size_t count = 0;
 		for (size_t i = 0; i < size; i++) {
-			if (std::memcmp(&table[i], &empty, sizeof(TTEntry))) count++;
+			if (table[i].key.load(std::memory_order_relaxed) || table[i].data.load(std::memory_order_relaxed)) count++;
 		}
 		return (double)count / (double)size * 100.0;
 	}